@@ -0,0 +1,20 @@
+#include "categorical.h"
+
+namespace csv {
+
+uint32_t Dictionary::Intern(std::string_view value) {
+  auto it = codes_.find(value);
+  if (it != codes_.end())
+    return it->second;
+  auto code = static_cast<uint32_t>(values_.size());
+  values_.emplace_back(value);
+  codes_.emplace(values_.back(), code);
+  return code;
+}
+
+uint32_t Dictionary::Find(std::string_view value) const {
+  auto it = codes_.find(value);
+  return it != codes_.end() ? it->second : kNotFound;
+}
+
+}  // namespace csv
@@ -0,0 +1,48 @@
+#ifndef CATEGORICAL_H
+#define CATEGORICAL_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace csv {
+
+// Interned strings of a categorical column, codes are given in the order of
+// the first appearance
+class Dictionary {
+ public:
+  static constexpr uint32_t kNotFound = UINT32_MAX;
+
+  Dictionary() = default;
+  // keys of the map point into the values storage, which keeps its
+  // addresses on moves only
+  Dictionary(const Dictionary&) = delete;
+  Dictionary& operator=(const Dictionary&) = delete;
+  Dictionary(Dictionary&&) = default;
+  Dictionary& operator=(Dictionary&&) = default;
+
+  uint32_t Intern(std::string_view value);
+  uint32_t Find(std::string_view value) const;
+
+  const std::string& operator[](uint32_t code) const { return values_[code]; }
+  size_t Size() const { return values_.size(); }
+
+ private:
+  std::deque<std::string> values_;
+  std::unordered_map<std::string_view, uint32_t> codes_;
+};
+
+// Dictionary encoded column, 4 bytes per row instead of a string
+struct CategoricalColumn {
+  Dictionary dictionary;
+  std::vector<uint32_t> codes;
+
+  const std::string& Value(size_t row) const { return dictionary[codes[row]]; }
+};
+
+}  // namespace csv
+
+#endif  // CATEGORICAL_H
@@ -0,0 +1,189 @@
+#include "column_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace csv {
+
+namespace {
+const size_t kBlockRows = 1024;
+// moments are merged from that many row ranges
+const size_t kPartitions = 64;
+
+// Moments of a block of rows, the block fits in the cache so the mean and
+// the M2 are computed with two passes over it
+void BlockMoments(const double* data,
+                  size_t rows,
+                  size_t cols,
+                  std::vector<double>& sums,
+                  std::vector<ColumnMoments>& moments) {
+  std::fill(sums.begin(), sums.end(), 0);
+  for (size_t c = 0; c < cols; ++c) {
+    moments[c].count = rows;
+    moments[c].min = data[c];
+    moments[c].max = data[c];
+    moments[c].m2 = 0;
+  }
+  for (size_t r = 0; r < rows; ++r) {
+    const auto* row = data + r * cols;
+    for (size_t c = 0; c < cols; ++c) {
+      sums[c] += row[c];
+      moments[c].min = std::min(moments[c].min, row[c]);
+      moments[c].max = std::max(moments[c].max, row[c]);
+    }
+  }
+  for (size_t c = 0; c < cols; ++c)
+    moments[c].mean = sums[c] / rows;
+  std::fill(sums.begin(), sums.end(), 0);
+  for (size_t r = 0; r < rows; ++r) {
+    const auto* row = data + r * cols;
+    for (size_t c = 0; c < cols; ++c) {
+      auto diff = row[c] - moments[c].mean;
+      sums[c] += diff * diff;
+    }
+  }
+  for (size_t c = 0; c < cols; ++c)
+    moments[c].m2 = sums[c];
+}
+}  // namespace
+
+void ColumnMoments::Merge(const ColumnMoments& other) {
+  if (other.count == 0)
+    return;
+  if (count == 0) {
+    *this = other;
+    return;
+  }
+  auto total = count + other.count;
+  auto delta = other.mean - mean;
+  mean += delta * other.count / total;
+  m2 += other.m2 + delta * delta * count * other.count / total;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  count = total;
+}
+
+double ColumnMoments::StdDev() const {
+  return std::sqrt(Variance());
+}
+
+ColumnStats ColumnStats::Compute(const double* data, size_t rows, size_t cols) {
+  ColumnStats stats(cols);
+  stats.Update(data, rows, cols);
+  return stats;
+}
+
+void ColumnStats::Update(const double* data, size_t rows, size_t cols) {
+  if (columns_.empty())
+    columns_.resize(cols);
+  const auto blocks_num = (rows + kBlockRows - 1) / kBlockRows;
+  const auto partitions_num = std::min(kPartitions, blocks_num);
+  std::vector<ColumnStats> partitions(partitions_num, ColumnStats(cols));
+#pragma omp parallel
+  {
+    std::vector<double> sums(cols);
+    std::vector<ColumnMoments> block_moments(cols);
+#pragma omp for schedule(dynamic)
+    for (size_t p = 0; p < partitions_num; ++p) {
+      auto first_block = p * blocks_num / partitions_num;
+      auto last_block = (p + 1) * blocks_num / partitions_num;
+      for (auto block = first_block; block < last_block; ++block) {
+        auto begin = block * kBlockRows;
+        auto end = std::min(rows, begin + kBlockRows);
+        BlockMoments(data + begin * cols, end - begin, cols, sums,
+                     block_moments);
+        for (size_t c = 0; c < cols; ++c)
+          partitions[p].columns_[c].Merge(block_moments[c]);
+      }
+    }
+  }
+  for (auto& partition : partitions)
+    Merge(partition);
+}
+
+void ColumnStats::Merge(const ColumnStats& other) {
+  if (columns_.empty())
+    columns_.resize(other.columns_.size());
+  for (size_t c = 0; c < columns_.size(); ++c)
+    columns_[c].Merge(other.columns_[c]);
+}
+
+void AffineScaler::SetParameters(std::vector<double> shift,
+                                 std::vector<double> scale) {
+  for (auto& s : scale) {
+    if (s == 0)
+      s = 1;
+  }
+  shift_ = std::move(shift);
+  scale_ = std::move(scale);
+}
+
+void AffineScaler::Transform(double* data, size_t rows, size_t cols) const {
+  std::vector<double> inv_scale(cols);
+  for (size_t c = 0; c < cols; ++c)
+    inv_scale[c] = 1 / scale_[c];
+  const auto* shift = shift_.data();
+  const auto* inv = inv_scale.data();
+  const auto blocks_num = (rows + kBlockRows - 1) / kBlockRows;
+#pragma omp parallel for schedule(static)
+  for (size_t block = 0; block < blocks_num; ++block) {
+    auto end = std::min(rows, (block + 1) * kBlockRows);
+    for (auto r = block * kBlockRows; r < end; ++r) {
+      auto* row = data + r * cols;
+#pragma omp simd
+      for (size_t c = 0; c < cols; ++c)
+        row[c] = (row[c] - shift[c]) * inv[c];
+    }
+  }
+}
+
+void AffineScaler::InverseTransform(double* data,
+                                    size_t rows,
+                                    size_t cols) const {
+  const auto* shift = shift_.data();
+  const auto* scale = scale_.data();
+  const auto blocks_num = (rows + kBlockRows - 1) / kBlockRows;
+#pragma omp parallel for schedule(static)
+  for (size_t block = 0; block < blocks_num; ++block) {
+    auto end = std::min(rows, (block + 1) * kBlockRows);
+    for (auto r = block * kBlockRows; r < end; ++r) {
+      auto* row = data + r * cols;
+#pragma omp simd
+      for (size_t c = 0; c < cols; ++c)
+        row[c] = row[c] * scale[c] + shift[c];
+    }
+  }
+}
+
+Standardizer::Standardizer(const ColumnStats& stats) {
+  std::vector<double> shift(stats.Size());
+  std::vector<double> scale(stats.Size());
+  for (size_t c = 0; c < stats.Size(); ++c) {
+    shift[c] = stats[c].mean;
+    scale[c] = stats[c].StdDev();
+  }
+  SetParameters(std::move(shift), std::move(scale));
+}
+
+MinMaxScaler::MinMaxScaler(const ColumnStats& stats) {
+  std::vector<double> shift(stats.Size());
+  std::vector<double> scale(stats.Size());
+  for (size_t c = 0; c < stats.Size(); ++c) {
+    shift[c] = stats[c].min;
+    scale[c] = stats[c].Range();
+  }
+  SetParameters(std::move(shift), std::move(scale));
+}
+
+MeanNormalizer::MeanNormalizer(const ColumnStats& stats) {
+  std::vector<double> shift(stats.Size());
+  std::vector<double> scale(stats.Size());
+  for (size_t c = 0; c < stats.Size(); ++c) {
+    shift[c] = stats[c].mean;
+    scale[c] = stats[c].Range();
+  }
+  SetParameters(std::move(shift), std::move(scale));
+}
+
+}  // namespace csv
@@ -0,0 +1,84 @@
+#ifndef COLUMN_STATS_H
+#define COLUMN_STATS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace csv {
+
+// Running moments of one column
+struct ColumnMoments {
+  size_t count{0};
+  double mean{0};
+  double m2{0};  // sum of squared differences from the mean
+  double min{0};
+  double max{0};
+
+  // Chan et al. parallel update of the Welford moments
+  void Merge(const ColumnMoments& other);
+
+  double Variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+  double StdDev() const;
+  double Range() const { return max - min; }
+};
+
+// Count, mean, M2, min and max of every column gathered in one pass over a
+// row-major table. Rows are processed in parallel in fixed partitions, the
+// moments of every block of rows are computed with two passes over the cached
+// block and merged in the partitions order, so the result does not depend on
+// the threads number. Tables read in chunks can be accumulated with Update.
+class ColumnStats {
+ public:
+  ColumnStats() = default;
+  explicit ColumnStats(size_t cols) : columns_(cols) {}
+
+  static ColumnStats Compute(const double* data, size_t rows, size_t cols);
+
+  void Update(const double* data, size_t rows, size_t cols);
+  void Merge(const ColumnStats& other);
+
+  size_t Size() const { return columns_.size(); }
+  const ColumnMoments& operator[](size_t col) const { return columns_[col]; }
+
+ private:
+  std::vector<ColumnMoments> columns_;
+};
+
+// Fitted per-column affine transformation x' = (x - shift) / scale applied in
+// place over blocks of rows
+class AffineScaler {
+ public:
+  void Transform(double* data, size_t rows, size_t cols) const;
+  void InverseTransform(double* data, size_t rows, size_t cols) const;
+
+ protected:
+  AffineScaler() = default;
+  // zero scales (constant columns) are replaced with 1
+  void SetParameters(std::vector<double> shift, std::vector<double> scale);
+
+ private:
+  std::vector<double> shift_;
+  std::vector<double> scale_;
+};
+
+// Zero mean and unit standard deviation
+class Standardizer : public AffineScaler {
+ public:
+  explicit Standardizer(const ColumnStats& stats);
+};
+
+// Values scaled to the [0, 1] range
+class MinMaxScaler : public AffineScaler {
+ public:
+  explicit MinMaxScaler(const ColumnStats& stats);
+};
+
+// Zero mean, values divided by the range
+class MeanNormalizer : public AffineScaler {
+ public:
+  explicit MeanNormalizer(const ColumnStats& stats);
+};
+
+}  // namespace csv
+
+#endif  // COLUMN_STATS_H
@@ -0,0 +1,377 @@
+#include "csv_reader.h"
+#include "mapped_file.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace csv {
+
+namespace {
+const size_t kMaxUnrolledColumns = 8;
+
+struct Chunk {
+  const char* begin{nullptr};
+  const char* end{nullptr};
+  size_t first_row{0};  // in the preallocated arrays
+  size_t lines{0};
+  size_t rows{0};  // parsed successfully
+};
+
+// Splits the text into about chunks_num parts which end after a newline
+std::vector<Chunk> SplitLines(const char* data,
+                              size_t size,
+                              size_t chunks_num) {
+  std::vector<Chunk> chunks;
+  const auto* end = data + size;
+  const auto* begin = data;
+  const auto step = std::max<size_t>(size / chunks_num, 1);
+  while (begin < end) {
+    const auto* chunk_end = begin + std::min(step, size_t(end - begin));
+    if (chunk_end < end) {
+      auto* newline = static_cast<const char*>(
+          std::memchr(chunk_end, '\n', size_t(end - chunk_end)));
+      chunk_end = newline ? newline + 1 : end;
+    }
+    chunks.push_back({begin, chunk_end});
+    begin = chunk_end;
+  }
+  return chunks;
+}
+
+const char* LineEnd(const char* begin, const char* end) {
+  auto* newline =
+      static_cast<const char*>(std::memchr(begin, '\n', size_t(end - begin)));
+  return newline ? newline : end;
+}
+
+size_t CountLines(const char* begin, const char* end) {
+  size_t lines = 0;
+  while (begin < end) {
+    ++lines;
+    begin = LineEnd(begin, end) + 1;
+  }
+  return lines;
+}
+
+const char* FieldEnd(const char* pos, const char* end, char delimiter) {
+  auto* field_end =
+      static_cast<const char*>(std::memchr(pos, delimiter, size_t(end - pos)));
+  return field_end ? field_end : end;
+}
+
+bool ExpectDelimiter(const char*& pos, const char* end, char delimiter) {
+  if (pos >= end || *pos != delimiter)
+    return false;
+  ++pos;
+  return true;
+}
+
+// Parses a number which has to fill the whole field
+bool ParseNumber(const char*& pos,
+                 const char* end,
+                 char delimiter,
+                 double& value) {
+  while (pos < end && *pos == ' ')
+    ++pos;
+  // from_chars does not accept the leading plus sign
+  if (pos < end && *pos == '+')
+    ++pos;
+  auto result = std::from_chars(pos, end, value);
+  if (result.ec != std::errc())
+    return false;
+  pos = result.ptr;
+  while (pos < end && *pos == ' ')
+    ++pos;
+  return pos == end || *pos == delimiter;
+}
+
+struct LineContext {
+  const Schema* schema{nullptr};
+  char delimiter{','};
+};
+
+// Parses one line without the newline, returns false for malformed lines
+using LineParser = bool (*)(const char* begin,
+                            const char* end,
+                            const LineContext& context,
+                            double* values,
+                            std::string_view* categories);
+
+bool ParseGeneric(const char* begin,
+                  const char* end,
+                  const LineContext& context,
+                  double* values,
+                  std::string_view* categories) {
+  const auto delimiter = context.delimiter;
+  const auto* pos = begin;
+  const auto& columns = context.schema->columns;
+  for (size_t c = 0; c < columns.size(); ++c) {
+    if (c > 0 && !ExpectDelimiter(pos, end, delimiter))
+      return false;
+    switch (columns[c]) {
+      case ColumnType::Numeric:
+        if (!ParseNumber(pos, end, delimiter, *values++))
+          return false;
+        break;
+      case ColumnType::Categorical: {
+        auto* field_end = FieldEnd(pos, end, delimiter);
+        *categories++ = std::string_view(pos, size_t(field_end - pos));
+        pos = field_end;
+        break;
+      }
+      case ColumnType::Skip:
+        pos = FieldEnd(pos, end, delimiter);
+        break;
+    }
+  }
+  return pos == end;
+}
+
+template <size_t... Idx>
+bool ParseNumbers(std::index_sequence<Idx...>,
+                  const char*& pos,
+                  const char* end,
+                  char delimiter,
+                  double* values) {
+  return (((Idx == 0 || ExpectDelimiter(pos, end, delimiter)) &&
+           ParseNumber(pos, end, delimiter, values[Idx])) &&
+          ...);
+}
+
+// Kernel for Numeric columns followed by an optional categorical one, the
+// fields loop is unrolled at compile time
+template <size_t Numeric, bool WithCategory>
+bool ParseFixed(const char* begin,
+                const char* end,
+                const LineContext& context,
+                double* values,
+                std::string_view* categories) {
+  const auto delimiter = context.delimiter;
+  const auto* pos = begin;
+  if (!ParseNumbers(std::make_index_sequence<Numeric>{}, pos, end, delimiter,
+                    values))
+    return false;
+  if (WithCategory) {
+    if (!ExpectDelimiter(pos, end, delimiter))
+      return false;
+    auto* field_end = FieldEnd(pos, end, delimiter);
+    *categories = std::string_view(pos, size_t(field_end - pos));
+    pos = field_end;
+  }
+  return pos == end;
+}
+
+template <bool WithCategory, size_t... N>
+constexpr std::array<LineParser, sizeof...(N)> MakeParsers(
+    std::index_sequence<N...>) {
+  return {{&ParseFixed<N + 1, WithCategory>...}};
+}
+
+LineParser SelectParser(const Schema& schema) {
+  static constexpr auto numeric_parsers =
+      MakeParsers<false>(std::make_index_sequence<kMaxUnrolledColumns>{});
+  static constexpr auto category_parsers =
+      MakeParsers<true>(std::make_index_sequence<kMaxUnrolledColumns>{});
+  const auto& columns = schema.columns;
+  auto numeric = schema.Count(ColumnType::Numeric);
+  auto categorical = schema.Count(ColumnType::Categorical);
+  bool numeric_first = std::all_of(
+      columns.begin(), columns.begin() + static_cast<long>(numeric),
+      [](ColumnType type) { return type == ColumnType::Numeric; });
+  if (numeric_first && numeric > 0 && numeric <= kMaxUnrolledColumns &&
+      numeric + categorical == columns.size() && categorical <= 1) {
+    return categorical == 0 ? numeric_parsers[numeric - 1]
+                            : category_parsers[numeric - 1];
+  }
+  return &ParseGeneric;
+}
+
+bool IsNumber(const char* begin, const char* end, char delimiter) {
+  if (begin == end)
+    return false;
+  double value = 0;
+  return ParseNumber(begin, end, delimiter, value) && begin == end;
+}
+}  // namespace
+
+Schema Schema::Infer(const char* text,
+                     size_t size,
+                     char delimiter,
+                     size_t lines_num) {
+  Schema schema;
+  const auto* end = text + size;
+  // numeric flags of the first line and of all other sampled lines
+  std::vector<bool> first_numeric;
+  std::vector<bool> numeric;
+  size_t lines = 0;
+  for (const auto* line = text; line < end && lines <= lines_num;) {
+    const auto* line_end = LineEnd(line, end);
+    auto* next = line_end + 1;
+    if (line_end > line && line_end[-1] == '\r')
+      --line_end;
+    if (line_end == line) {
+      line = next;
+      continue;
+    }
+    std::vector<bool> flags;
+    for (const auto* pos = line;;) {
+      auto* field_end = FieldEnd(pos, line_end, delimiter);
+      flags.push_back(IsNumber(pos, field_end, delimiter));
+      if (field_end == line_end)
+        break;
+      pos = field_end + 1;
+    }
+    if (lines == 0) {
+      first_numeric = flags;
+    } else if (numeric.empty()) {
+      numeric = flags;
+    } else {
+      for (size_t c = 0; c < std::min(numeric.size(), flags.size()); ++c)
+        numeric[c] = numeric[c] && flags[c];
+    }
+    ++lines;
+    line = next;
+  }
+  if (numeric.empty()) {
+    numeric = first_numeric;
+  } else {
+    for (size_t c = 0; c < std::min(numeric.size(), first_numeric.size());
+         ++c) {
+      if (numeric[c] && !first_numeric[c])
+        schema.header = true;
+    }
+    if (!schema.header) {
+      for (size_t c = 0; c < std::min(numeric.size(), first_numeric.size());
+           ++c)
+        numeric[c] = numeric[c] && first_numeric[c];
+    }
+  }
+  for (auto is_numeric : numeric)
+    schema.columns.push_back(is_numeric ? ColumnType::Numeric
+                                        : ColumnType::Categorical);
+  return schema;
+}
+
+size_t Schema::Count(ColumnType type) const {
+  return static_cast<size_t>(std::count(columns.begin(), columns.end(), type));
+}
+
+CsvData ReadCsv(const std::string& file_name, const CsvReadOptions& options) {
+  CsvData data;
+  MappedFile file(file_name);
+  if (!file.IsOpen() || file.Size() == 0)
+    return data;
+
+  const auto* text = file.Data();
+  auto size = file.Size();
+  data.schema = options.schema.columns.empty()
+                    ? Schema::Infer(text, size, options.delimiter)
+                    : options.schema;
+  if (data.schema.header) {
+    auto* body = LineEnd(text, text + size);
+    body = std::min(body + 1, text + size);
+    size -= size_t(body - text);
+    text = body;
+  }
+  const auto cols = data.schema.Count(ColumnType::Numeric);
+  const auto categorical_cols = data.schema.Count(ColumnType::Categorical);
+  data.cols = cols;
+  LineContext context{&data.schema, options.delimiter};
+  auto parser = SelectParser(data.schema);
+
+  auto chunks_num = options.chunks > 0
+                        ? options.chunks
+                        : static_cast<size_t>(omp_get_max_threads()) * 4;
+  auto chunks = SplitLines(text, size, chunks_num);
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < chunks.size(); ++i)
+    chunks[i].lines = CountLines(chunks[i].begin, chunks[i].end);
+  size_t total_lines = 0;
+  for (auto& chunk : chunks) {
+    chunk.first_row = total_lines;
+    total_lines += chunk.lines;
+  }
+
+  data.values.resize(total_lines * cols);
+  auto* values = data.values.data();
+  data.categorical.resize(categorical_cols);
+  for (auto& column : data.categorical)
+    column.codes.resize(total_lines);
+  // chunk local dictionaries, chunk_dictionaries[chunk][column]
+  std::vector<std::vector<Dictionary>> chunk_dictionaries(chunks.size());
+
+#pragma omp parallel
+  {
+    std::vector<std::string_view> categories(categorical_cols);
+#pragma omp for schedule(dynamic)
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      auto& chunk = chunks[i];
+      auto& dictionaries = chunk_dictionaries[i];
+      dictionaries.resize(categorical_cols);
+      for (const auto* line = chunk.begin; line < chunk.end;) {
+        const auto* line_end = LineEnd(line, chunk.end);
+        const auto* next = line_end + 1;
+        if (line_end > line && line_end[-1] == '\r')
+          --line_end;
+        auto row = chunk.first_row + chunk.rows;
+        if (line_end > line &&
+            parser(line, line_end, context, values + row * cols,
+                   categories.data())) {
+          for (size_t c = 0; c < categorical_cols; ++c)
+            data.categorical[c].codes[row] =
+                dictionaries[c].Intern(categories[c]);
+          ++chunk.rows;
+        }
+        line = next;
+      }
+    }
+  }
+
+  // the global codes are given in the order of the first appearance in the
+  // file, chunk codes are translated in parallel
+  for (size_t c = 0; c < categorical_cols; ++c) {
+    auto& column = data.categorical[c];
+    std::vector<std::vector<uint32_t>> remaps(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      auto& local = chunk_dictionaries[i][c];
+      remaps[i].resize(local.Size());
+      for (uint32_t code = 0; code < local.Size(); ++code)
+        remaps[i][code] = column.dictionary.Intern(local[code]);
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      auto* codes = column.codes.data() + chunks[i].first_row;
+      for (size_t r = 0; r < chunks[i].rows; ++r)
+        codes[r] = remaps[i][codes[r]];
+    }
+  }
+
+  // stitch the chunks together if some lines were skipped
+  size_t rows = 0;
+  for (auto& chunk : chunks) {
+    if (chunk.first_row != rows) {
+      std::copy_n(values + chunk.first_row * cols, chunk.rows * cols,
+                  values + rows * cols);
+      for (auto& column : data.categorical)
+        std::copy_n(column.codes.begin() + chunk.first_row, chunk.rows,
+                    column.codes.begin() + rows);
+    }
+    rows += chunk.rows;
+  }
+  data.rows = rows;
+  data.skipped_lines = total_lines - rows;
+  data.values.resize(rows * cols);
+  for (auto& column : data.categorical)
+    column.codes.resize(rows);
+  return data;
+}
+
+}  // namespace csv
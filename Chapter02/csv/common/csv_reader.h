@@ -0,0 +1,58 @@
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#include "categorical.h"
+
+#include <string>
+#include <vector>
+
+namespace csv {
+
+enum class ColumnType { Numeric, Categorical, Skip };
+
+struct Schema {
+  std::vector<ColumnType> columns;
+  bool header{false};  // the first line holds column names
+
+  // Column types guessed from the first lines of the text: columns where all
+  // values are numbers are numeric, others are categorical. The first line
+  // is a header if it has text in a numeric column.
+  static Schema Infer(const char* text,
+                      size_t size,
+                      char delimiter = ',',
+                      size_t lines_num = 100);
+
+  size_t Count(ColumnType type) const;
+};
+
+struct CsvReadOptions {
+  char delimiter{','};
+  Schema schema;     // inferred from the file if empty
+  size_t chunks{0};  // file parts parsed in parallel, 0 - 4 per thread
+};
+
+struct CsvData {
+  Schema schema;
+  // rows x numeric columns, row-major
+  std::vector<double> values;
+  std::vector<CategoricalColumn> categorical;
+  size_t rows{0};
+  size_t cols{0};  // numeric columns
+  size_t skipped_lines{0};  // empty or malformed lines
+};
+
+// Parallel CSV reader. The file is memory mapped and split into chunks at
+// newline boundaries. Lines of every chunk are counted first, so each chunk
+// parses straight into its own preallocated slice of the one contiguous
+// row-major array; slices are moved together only if some lines were
+// skipped. Lines are parsed with a kernel chosen for the schema at runtime:
+// layouts of up to 8 numeric columns followed by an optional categorical one
+// have kernels unrolled at compile time, other layouts use the generic one.
+// Categorical values are interned into per-chunk dictionaries while parsing,
+// which are merged in the chunks order afterwards.
+CsvData ReadCsv(const std::string& file_name,
+                const CsvReadOptions& options = {});
+
+}  // namespace csv
+
+#endif  // CSV_READER_H
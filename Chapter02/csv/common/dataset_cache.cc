@@ -0,0 +1,278 @@
+#include "dataset_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace csv {
+
+struct CacheKey {
+  uint64_t size{0};
+  int64_t mtime{0};  // nanoseconds
+  uint64_t hash{0};
+  uint32_t delimiter{0};  // the file is parsed with
+  uint32_t reserved{0};
+};
+
+namespace {
+const char kMagic[8] = {'C', 'S', 'V', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t kVersion = 2;
+const uint64_t kAlignment = 64;
+// bytes hashed at the beginning and at the end of the CSV file
+const size_t kHashedBytes = 1 << 16;
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t has_header;  // the CSV schema header flag
+  CacheKey key;
+  uint64_t rows;
+  uint64_t columns;  // in the schema
+  uint64_t cols;     // numeric
+  uint64_t categorical_cols;
+  uint64_t values_offset;
+  uint64_t codes_offset;
+  uint64_t dictionaries_offset;
+  uint64_t file_size;
+};
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Checks that count items of item_size bytes at the offset end before limit,
+// without overflows for any header values
+bool InRange(uint64_t offset,
+             uint64_t count,
+             uint64_t item_size,
+             uint64_t limit) {
+  if (offset > limit)
+    return false;
+  return item_size == 0 || count <= (limit - offset) / item_size;
+}
+
+// FNV-1a
+uint64_t Hash(const char* data, size_t size, uint64_t hash) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool ReadKey(const std::string& file_name, CacheKey& key) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat file_stat;
+  bool ok = fstat(fd, &file_stat) == 0;
+  if (ok) {
+    key.size = static_cast<uint64_t>(file_stat.st_size);
+    key.mtime = int64_t(file_stat.st_mtim.tv_sec) * 1000000000 +
+                file_stat.st_mtim.tv_nsec;
+    std::vector<char> buffer(kHashedBytes);
+    key.hash = 14695981039346656037ULL;
+    auto head = pread(fd, buffer.data(), buffer.size(), 0);
+    ok = head >= 0;
+    if (ok)
+      key.hash = Hash(buffer.data(), size_t(head), key.hash);
+    if (ok && key.size > kHashedBytes) {
+      auto tail = pread(fd, buffer.data(), buffer.size(),
+                        static_cast<off_t>(key.size - kHashedBytes));
+      ok = tail >= 0;
+      if (ok)
+        key.hash = Hash(buffer.data(), size_t(tail), key.hash);
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+bool operator==(const CacheKey& a, const CacheKey& b) {
+  return a.size == b.size && a.mtime == b.mtime && a.hash == b.hash &&
+         a.delimiter == b.delimiter;
+}
+
+void Pad(std::ofstream& out, uint64_t offset) {
+  static const char zeros[kAlignment] = {};
+  auto pos = static_cast<uint64_t>(out.tellp());
+  // offsets are aligned section starts, so the gap is always shorter
+  assert(offset >= pos && offset - pos < kAlignment);
+  out.write(zeros, static_cast<std::streamsize>(offset - pos));
+}
+
+// The cache is written to a temporary file which replaces the old one, so
+// readers never see a partial file
+bool Write(const std::string& file_name,
+           const CacheKey& key,
+           const CsvData& data) {
+  CacheHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.has_header = data.schema.header;
+  header.key = key;
+  header.rows = data.rows;
+  header.columns = data.schema.columns.size();
+  header.cols = data.cols;
+  header.categorical_cols = data.categorical.size();
+  header.values_offset = Align(sizeof(CacheHeader) + header.columns);
+  header.codes_offset =
+      Align(header.values_offset + data.rows * data.cols * sizeof(double));
+  header.dictionaries_offset =
+      header.codes_offset +
+      header.categorical_cols * Align(data.rows * sizeof(uint32_t));
+
+  auto temp_name = file_name + ".tmp";
+  std::ofstream out(temp_name, std::ios::binary | std::ios::trunc);
+  if (!out)
+    return false;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (auto type : data.schema.columns) {
+    auto code = static_cast<char>(type);
+    out.write(&code, 1);
+  }
+  Pad(out, header.values_offset);
+  out.write(reinterpret_cast<const char*>(data.values.data()),
+            static_cast<std::streamsize>(data.values.size() * sizeof(double)));
+  for (size_t c = 0; c < data.categorical.size(); ++c) {
+    Pad(out, header.codes_offset + c * Align(data.rows * sizeof(uint32_t)));
+    auto& codes = data.categorical[c].codes;
+    out.write(reinterpret_cast<const char*>(codes.data()),
+              static_cast<std::streamsize>(codes.size() * sizeof(uint32_t)));
+  }
+  Pad(out, header.dictionaries_offset);
+  for (auto& column : data.categorical) {
+    auto count = static_cast<uint32_t>(column.dictionary.Size());
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (uint32_t code = 0; code < count; ++code) {
+      auto& value = column.dictionary[code];
+      auto length = static_cast<uint32_t>(value.size());
+      out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+      out.write(value.data(), length);
+    }
+  }
+  header.file_size = static_cast<uint64_t>(out.tellp());
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.close();
+  if (!out) {
+    std::remove(temp_name.c_str());
+    return false;
+  }
+  return std::rename(temp_name.c_str(), file_name.c_str()) == 0;
+}
+}  // namespace
+
+std::unique_ptr<DatasetCache> DatasetCache::Open(
+    const std::string& csv_file_name,
+    const CsvReadOptions& options) {
+  auto start = std::chrono::steady_clock::now();
+  CacheKey key;
+  if (!ReadKey(csv_file_name, key))
+    return nullptr;
+  key.delimiter = static_cast<unsigned char>(options.delimiter);
+  std::unique_ptr<DatasetCache> cache(new DatasetCache());
+  auto cache_file_name = csv_file_name + ".cache";
+  // a cache written for another schema can not be reused
+  cache->from_cache_ = cache->Load(cache_file_name, key) &&
+                      (options.schema.columns.empty() ||
+                       options.schema.columns == cache->schema_.columns);
+  if (!cache->from_cache_) {
+    cache.reset(new DatasetCache());
+    auto data = ReadCsv(csv_file_name, options);
+    cache->write_failed_ = !Write(cache_file_name, key, data);
+    cache->Adopt(std::move(data));
+  }
+  std::chrono::duration<double> load_time =
+      std::chrono::steady_clock::now() - start;
+  cache->load_seconds_ = load_time.count();
+  return cache;
+}
+
+bool DatasetCache::Load(const std::string& cache_file_name,
+                        const CacheKey& key) {
+  file_ = std::make_unique<MappedFile>(cache_file_name, true);
+  auto* data = file_->MutableData();
+  auto size = file_->Size();
+  if (!data || size < sizeof(CacheHeader))
+    return false;
+  CacheHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || !(header.key == key) ||
+      header.file_size != size)
+    return false;
+  // every array must lie in its own part of the file, before the next one
+  const uint64_t codes_size = Align(header.rows * sizeof(uint32_t));
+  if (header.values_offset % kAlignment != 0 ||
+      header.codes_offset % kAlignment != 0 ||
+      !InRange(sizeof(CacheHeader), header.columns, 1,
+               header.values_offset) ||
+      header.cols > size / sizeof(double) ||
+      header.rows > size / sizeof(uint32_t) ||
+      !InRange(header.values_offset, header.rows,
+               header.cols * sizeof(double), header.codes_offset) ||
+      !InRange(header.codes_offset, header.categorical_cols, codes_size,
+               header.dictionaries_offset) ||
+      header.dictionaries_offset > size)
+    return false;
+
+  schema_.header = header.has_header != 0;
+  for (uint64_t c = 0; c < header.columns; ++c)
+    schema_.columns.push_back(
+        static_cast<ColumnType>(data[sizeof(CacheHeader) + c]));
+  if (schema_.Count(ColumnType::Numeric) != header.cols ||
+      schema_.Count(ColumnType::Categorical) != header.categorical_cols)
+    return false;
+  rows_ = header.rows;
+  cols_ = header.cols;
+  values_ = reinterpret_cast<double*>(data + header.values_offset);
+  for (uint64_t c = 0; c < header.categorical_cols; ++c) {
+    codes_.push_back(reinterpret_cast<const uint32_t*>(
+        data + header.codes_offset + c * codes_size));
+  }
+
+  const auto* pos = data + header.dictionaries_offset;
+  const auto* end = data + size;
+  for (uint64_t c = 0; c < header.categorical_cols; ++c) {
+    Dictionary dictionary;
+    uint32_t count = 0;
+    if (end - pos < 4)
+      return false;
+    std::memcpy(&count, pos, sizeof(count));
+    pos += sizeof(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t length = 0;
+      if (end - pos < 4)
+        return false;
+      std::memcpy(&length, pos, sizeof(length));
+      pos += sizeof(length);
+      if (uint64_t(end - pos) < length)
+        return false;
+      dictionary.Intern(std::string_view(pos, length));
+      pos += length;
+    }
+    dictionaries_.push_back(std::move(dictionary));
+  }
+  return true;
+}
+
+void DatasetCache::Adopt(CsvData data) {
+  data_ = std::move(data);
+  schema_ = data_.schema;
+  rows_ = data_.rows;
+  cols_ = data_.cols;
+  values_ = data_.values.data();
+  for (auto& column : data_.categorical) {
+    codes_.push_back(column.codes.data());
+    dictionaries_.push_back(std::move(column.dictionary));
+  }
+}
+
+}  // namespace csv
@@ -0,0 +1,71 @@
+#ifndef DATASET_CACHE_H
+#define DATASET_CACHE_H
+
+#include "categorical.h"
+#include "csv_reader.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace csv {
+
+struct CacheKey;
+
+// Parsed CSV dataset backed by a binary sidecar file "<csv file>.cache".
+// The cache keeps the schema, the numeric values as one 64-byte aligned
+// row-major array, one uint32 codes array per categorical column and the
+// dictionaries. It is keyed by the CSV file size, modification time, a hash
+// of its head and tail and the delimiter; a stale, damaged or missing cache
+// is rebuilt from the CSV. A valid cache is memory mapped copy-on-write, so
+// the values can be viewed (and changed in place) by Eigen, dlib, Shark or
+// Shogun without a copy.
+class DatasetCache {
+ public:
+  static std::unique_ptr<DatasetCache> Open(
+      const std::string& csv_file_name,
+      const CsvReadOptions& options = {});
+
+  size_t Rows() const { return rows_; }
+  size_t Cols() const { return cols_; }
+  double* Values() const { return values_; }
+
+  size_t CategoricalCols() const { return codes_.size(); }
+  const uint32_t* Codes(size_t column) const { return codes_[column]; }
+  const Dictionary& GetDictionary(size_t column) const {
+    return dictionaries_[column];
+  }
+  const Schema& GetSchema() const { return schema_; }
+
+  bool FromCache() const { return from_cache_; }
+  // The data was parsed but the cache file could not be written, so the
+  // next run parses the CSV again
+  bool WriteFailed() const { return write_failed_; }
+  double LoadSeconds() const { return load_seconds_; }
+
+ private:
+  DatasetCache() = default;
+
+  bool Load(const std::string& cache_file_name, const CacheKey& key);
+  void Adopt(CsvData data);
+
+  Schema schema_;
+  size_t rows_{0};
+  size_t cols_{0};
+  double* values_{nullptr};
+  std::vector<const uint32_t*> codes_;
+  std::vector<Dictionary> dictionaries_;
+  bool from_cache_{false};
+  bool write_failed_{false};
+  double load_seconds_{0};
+
+  // storage: the mapped cache or the freshly parsed data
+  std::unique_ptr<MappedFile> file_;
+  CsvData data_;
+};
+
+}  // namespace csv
+
+#endif  // DATASET_CACHE_H
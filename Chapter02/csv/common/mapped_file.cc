@@ -0,0 +1,44 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace csv {
+
+MappedFile::MappedFile(const std::string& file_name, bool copy_on_write)
+    : copy_on_write_(copy_on_write) {
+  fd_ = open(file_name.c_str(), O_RDONLY);
+  if (fd_ < 0)
+    return;
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) != 0) {
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  size_ = static_cast<size_t>(file_stat.st_size);
+  if (size_ == 0)
+    return;
+  auto protection = copy_on_write_ ? PROT_READ | PROT_WRITE : PROT_READ;
+  auto* data = mmap(nullptr, size_, protection, MAP_PRIVATE, fd_, 0);
+  if (data == MAP_FAILED) {
+    close(fd_);
+    fd_ = -1;
+    size_ = 0;
+    return;
+  }
+  // the file is scanned front to back by every thread
+  madvise(data, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<char*>(data);
+}
+
+MappedFile::~MappedFile() {
+  if (data_)
+    munmap(data_, size_);
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+}  // namespace csv
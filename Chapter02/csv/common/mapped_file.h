@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace csv {
+
+// Memory mapping of a whole file. With copy_on_write the pages can be
+// changed, the changes are private and never written back to the file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& file_name,
+                      bool copy_on_write = false);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool IsOpen() const { return data_ != nullptr || (fd_ >= 0 && size_ == 0); }
+  const char* Data() const { return data_; }
+  char* MutableData() const { return copy_on_write_ ? data_ : nullptr; }
+  size_t Size() const { return size_; }
+
+ private:
+  int fd_{-1};
+  char* data_{nullptr};
+  bool copy_on_write_{false};
+  size_t size_{0};
+};
+
+}  // namespace csv
+
+#endif  // MAPPED_FILE_H
@@ -1,4 +1,6 @@
-#include <csv.h>
+#include "../common/column_stats.h"
+#include "../common/dataset_cache.h"
+
 #include <Eigen/Dense>
 
 #include <experimental/filesystem>
@@ -7,85 +9,66 @@
 
 namespace fs = std::experimental::filesystem;
 
-template <std::size_t... Idx, typename T, typename R>
-bool read_row_help(std::index_sequence<Idx...>, T& row, R& r) {
-  return r.read_row(std::get<Idx>(row)...);
-}
-
-template <std::size_t... Idx, typename T>
-void fill_values(std::index_sequence<Idx...>,
-                 T& row,
-                 std::vector<double>& data) {
-  data.insert(data.end(), {std::get<Idx>(row)...});
-}
-
 int main(int argc, char** argv) {
   if (argc > 1) {
     auto file_path = fs::path(argv[1]);
     if (fs::exists(file_path)) {
-      const uint32_t columns_num = 5;
-      io::CSVReader<columns_num> csv_reader(file_path);
-
-      std::vector<std::string> categorical_column;
-      std::vector<double> values;
-      using RowType = std::tuple<double, double, double, double, std::string>;
-      RowType row;
-
-      uint32_t rows_num = 0;
-      try {
-        bool done = false;
-        while (!done) {
-          done = !read_row_help(
-              std::make_index_sequence<std::tuple_size<RowType>::value>{}, row,
-              csv_reader);
-          if (!done) {
-            categorical_column.push_back(std::get<4>(row));
-            fill_values(std::make_index_sequence<columns_num - 1>{}, row,
-                        values);
-            ++rows_num;
-          }
-        }
-      } catch (const io::error::no_digit& err) {
-        // ignore bad formated samples
-        std::cerr << err.what() << std::endl;
+      // the schema is inferred from the file, it is parsed in parallel
+      // straight into one row-major array of the numeric columns; later runs
+      // map the binary cache written next to the file
+      auto data = csv::DatasetCache::Open(file_path.string());
+      if (!data) {
+        std::cerr << "Failed to read " << file_path << std::endl;
+        return 1;
+      }
+      std::cout << (data->FromCache() ? "Warm" : "Cold")
+                << " load time: " << data->LoadSeconds() << "s" << std::endl;
+      if (data->WriteFailed())
+        std::cerr << "Failed to write the cache of " << argv[1] << std::endl;
+      std::cout << "Numeric columns: " << data->Cols()
+                << " categorical columns: " << data->CategoricalCols()
+                << std::endl;
+      // labels are dictionary encoded while parsing
+      for (size_t c = 0; c < data->CategoricalCols(); ++c) {
+        auto& dictionary = data->GetDictionary(c);
+        for (uint32_t code = 0; code < dictionary.Size(); ++code)
+          std::cout << dictionary[code] << " - " << code << "\n";
       }
 
+      // the cache pages are copy-on-write, scaling in place does not change
+      // the file
       auto x_data = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic,
                                              Eigen::Dynamic, Eigen::RowMajor>>(
-          values.data(), rows_num, columns_num - 1);
+          data->Values(), data->Rows(), data->Cols());
 
       std::cout << x_data << std::endl;
 
       // Feature-scaling(Normalization):
-      // Standardization - zero mean + 1 std
-      Eigen::Array<double, 1, Eigen::Dynamic> std_dev =
-          ((x_data.rowwise() - x_data.colwise().mean())
-               .array()
-               .square()
-               .colwise()
-               .sum() /
-           (x_data.rows() - 1))
-              .sqrt();
-
-      Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> x_data_std =
-          (x_data.rowwise() - x_data.colwise().mean()).array().rowwise() /
-          std_dev;
+      // column statistics are gathered in one pass and fit the scaler, the
+      // values are scaled in place without a copy of the table. Min-max and
+      // average normalization do not depend on a previous per-column affine
+      // scaling, so they are fitted to the already scaled values.
+      auto stats = csv::ColumnStats::Compute(x_data.data(), x_data.rows(),
+                                             x_data.cols());
 
-      std::cout << x_data_std << std::endl;
+      // Standardization - zero mean + 1 std
+      csv::Standardizer standardizer(stats);
+      standardizer.Transform(x_data.data(), x_data.rows(), x_data.cols());
+      std::cout << x_data << std::endl;
 
       // Min-Max normalization
-      Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> x_data_min_max =
-          (x_data.rowwise() - x_data.colwise().minCoeff()).array().rowwise() /
-          (x_data.colwise().maxCoeff() - x_data.colwise().minCoeff()).array();
-
-      std::cout << x_data_min_max << std::endl;
+      stats = csv::ColumnStats::Compute(x_data.data(), x_data.rows(),
+                                        x_data.cols());
+      csv::MinMaxScaler min_max_scaler(stats);
+      min_max_scaler.Transform(x_data.data(), x_data.rows(), x_data.cols());
+      std::cout << x_data << std::endl;
 
       // Average normalization
-      Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> x_data_avg =
-          (x_data.rowwise() - x_data.colwise().mean()).array().rowwise() /
-          (x_data.colwise().maxCoeff() - x_data.colwise().minCoeff()).array();
-
-      std::cout << x_data_avg << std::endl;
+      stats = csv::ColumnStats::Compute(x_data.data(), x_data.rows(),
+                                        x_data.cols());
+      csv::MeanNormalizer mean_normalizer(stats);
+      mean_normalizer.Transform(x_data.data(), x_data.rows(), x_data.cols());
+      std::cout << x_data << std::endl;
 
     } else {
       std::cout << "File path is incorrect " << file_path << "\n";
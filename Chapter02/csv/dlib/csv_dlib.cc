@@ -1,41 +1,38 @@
+#include "../common/dataset_cache.h"
+
 #include <dlib/dnn.h>
 #include <dlib/matrix.h>
 
 #include <experimental/filesystem>
 #include <iostream>
 #include <random>
-#include <regex>
-#include <sstream>
 namespace fs = std::experimental::filesystem;
 
 int main(int argc, char** argv) {
   using namespace dlib;
   if (argc > 1) {
     if (fs::exists(argv[1])) {
-      std::stringstream str_stream;
-      {
-        // replace categorial values with numeric ones
-        std::ifstream data_stream(argv[1]);
-        std::string data_string((std::istreambuf_iterator<char>(data_stream)),
-                                std::istreambuf_iterator<char>());
-
-        // replace string labels, because SharkML parssr can't handle strings
-        data_string =
-            std::regex_replace(data_string, std::regex("Iris-setosa"), "1");
-        data_string =
-            std::regex_replace(data_string, std::regex("Iris-versicolor"), "2");
-        data_string =
-            std::regex_replace(data_string, std::regex("Iris-virginica"), "3");
-
-        str_stream << data_string;
+      // the parsed file is cached next to it, later runs map the cache
+      auto dataset = csv::DatasetCache::Open(argv[1]);
+      if (!dataset) {
+        std::cerr << "Failed to read " << argv[1] << std::endl;
+        return 1;
       }
-
-      matrix<double> data;
-      str_stream >> data;
-
-      std::cout << data << std::endl;
-
-      matrix<double> x_data = subm(data, 0, 0, data.nr(), data.nc() - 1);
+      std::cout << (dataset->FromCache() ? "Warm" : "Cold")
+                << " load time: " << dataset->LoadSeconds() << "s"
+                << std::endl;
+      if (dataset->WriteFailed())
+        std::cerr << "Failed to write the cache of " << argv[1] << std::endl;
+
+      // class names are dictionary encoded while parsing
+      auto& dictionary = dataset->GetDictionary(0);
+      for (uint32_t code = 0; code < dictionary.Size(); ++code)
+        std::cout << dictionary[code] << " - " << code + 1 << std::endl;
+
+      // view of the cached values without a copy
+      auto x_data = mat(dataset->Values(), static_cast<long>(dataset->Rows()),
+                        static_cast<long>(dataset->Cols()));
+      std::cout << x_data << std::endl;
 
       std::vector<matrix<double>> samples;
       for (int r = 0; r < x_data.nr(); ++r) {
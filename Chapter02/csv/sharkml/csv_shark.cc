@@ -1,11 +1,12 @@
+#include "../common/dataset_cache.h"
+
 #include <shark/Algorithms/Trainers/NormalizeComponentsUnitVariance.h>
-#include <shark/Data/Csv.h>
 #include <shark/Data/Dataset.h>
 #include <shark/Models/Normalizer.h>
 
 #include <experimental/filesystem>
 #include <iostream>
-#include <regex>
+#include <vector>
 namespace fs = std::experimental::filesystem;
 
 using namespace shark;
@@ -14,22 +15,33 @@ int main(int argc, char** argv) {
   try {
     if (argc > 1) {
       if (fs::exists(argv[1])) {
-        // we need to preprocess dataset because SharkML fails to load csv with
-        // string values
-        std::ifstream data_stream(argv[1]);
-        std::string data_string((std::istreambuf_iterator<char>(data_stream)),
-                                std::istreambuf_iterator<char>());
-
-        // replace string labels, because SharkML parssr can't handle strings
-        data_string =
-            std::regex_replace(data_string, std::regex("Iris-setosa"), "1");
-        data_string =
-            std::regex_replace(data_string, std::regex("Iris-versicolor"), "2");
-        data_string =
-            std::regex_replace(data_string, std::regex("Iris-virginica"), "3");
-
-        ClassificationDataset dataset;
-        csvStringToData(dataset, data_string, LAST_COLUMN);
+        // the parsed file is cached next to it, later runs map the cache;
+        // class names are dictionary encoded while parsing, so no string
+        // labels reach the SharkML containers
+        auto cache = csv::DatasetCache::Open(argv[1]);
+        if (!cache || cache->Rows() == 0 || cache->CategoricalCols() == 0) {
+          std::cerr << "No samples with a class column in " << argv[1]
+                    << std::endl;
+          return 1;
+        }
+        std::cout << (cache->FromCache() ? "Warm" : "Cold")
+                  << " load time: " << cache->LoadSeconds() << "s"
+                  << std::endl;
+        if (cache->WriteFailed())
+          std::cerr << "Failed to write the cache of " << argv[1] << std::endl;
+
+        // SharkML stores samples in its own batches, they are filled from a
+        // view of the cached values
+        auto values = blas::adapt_matrix(cache->Rows(), cache->Cols(),
+                                         cache->Values());
+        std::vector<RealVector> inputs(cache->Rows());
+        std::vector<unsigned int> labels(cache->Rows());
+        for (std::size_t r = 0; r < cache->Rows(); ++r) {
+          inputs[r] = row(values, r);
+          labels[r] = cache->Codes(0)[r];
+        }
+        ClassificationDataset dataset =
+            createLabeledDataFromRange(inputs, labels);
         dataset.shuffle();
         std::size_t classes = numberOfClasses(dataset);
         std::cout << "Number of classes " << classes << std::endl;
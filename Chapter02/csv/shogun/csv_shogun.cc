@@ -1,17 +1,15 @@
+#include "../common/dataset_cache.h"
+
 #include <shogun/base/init.h>
 #include <shogun/base/some.h>
-#include <shogun/io/File.h>
 #include <shogun/labels/MulticlassLabels.h>
 #include <shogun/lib/SGMatrix.h>
-#include <shogun/lib/SGStringList.h>
 #include <shogun/lib/SGVector.h>
 #include <shogun/preprocessor/RescaleFeatures.h>
 #include <shogun/util/factory.h>
 
 #include <experimental/filesystem>
-#include <fstream>
 #include <iostream>
-#include <regex>
 
 namespace fs = std::experimental::filesystem;
 
@@ -22,38 +20,29 @@ using Matrix = shogun::SGMatrix<DataType>;
 int main(int argc, char** argv) {
   shogun::init_shogun_with_defaults();
   if (argc > 1 && fs::exists(argv[1])) {
-    // we need to convert label to numbers to read whole file with shogun
-    // functions
-    {
-      std::ifstream data_stream(argv[1]);
-      std::string data_string((std::istreambuf_iterator<char>(data_stream)),
-                              std::istreambuf_iterator<char>());
-
-      // replace string labels, because SharkML parssr can't handle strings
-      data_string =
-          std::regex_replace(data_string, std::regex("Iris-setosa"), "1");
-      data_string =
-          std::regex_replace(data_string, std::regex("Iris-versicolor"), "2");
-      data_string =
-          std::regex_replace(data_string, std::regex("Iris-virginica"), "3");
-      std::ofstream out_stream("iris_fix.csv");
-      out_stream << data_string;
+    // Shogun algorithms expect samples in columns of a column-major matrix,
+    // so a features x samples SGMatrix has the same memory layout as the
+    // row-major samples x features array of the dataset cache: the matrix is
+    // a view of the mapped values. Class names are dictionary encoded while
+    // parsing and become labels starting from 1.
+    auto cache = csv::DatasetCache::Open(argv[1]);
+    if (!cache || cache->Rows() == 0 || cache->CategoricalCols() == 0) {
+      std::cerr << "No samples with a class column in " << argv[1]
+                << std::endl;
+      shogun::exit_shogun();
+      return 1;
     }
+    std::cout << (cache->FromCache() ? "Warm" : "Cold")
+              << " load time: " << cache->LoadSeconds() << "s" << std::endl;
+    if (cache->WriteFailed())
+      std::cerr << "Failed to write the cache of " << argv[1] << std::endl;
+    Matrix inputs(cache->Values(), static_cast<index_t>(cache->Cols()),
+                  static_cast<index_t>(cache->Rows()), false);
 
-    auto csv_file = shogun::some<shogun::CCSVFile>("iris_fix.csv");
-    Matrix data;
-    data.load(csv_file);
-
-    // Exclude classification info from data
-    // Shogun csv loader loads matrixes in column major order
-    Matrix::transpose_matrix(data.matrix, data.num_rows, data.num_cols);
-    Matrix inputs = data.submatrix(0, data.num_cols - 1);  // make a view
-    inputs = inputs.clone();                               // copy exact data
-    Matrix outputs = data.submatrix(4, 5);                 // make a view
-    outputs = outputs.clone();                             // copy exact data
-    // Transpose back because shogun algorithms expect that samples are in
-    // colums
-    Matrix::transpose_matrix(inputs.matrix, inputs.num_rows, inputs.num_cols);
+    const auto* codes = cache->Codes(0);
+    shogun::SGVector<DataType> outputs(static_cast<index_t>(cache->Rows()));
+    for (size_t r = 0; r < cache->Rows(); ++r)
+      outputs[static_cast<index_t>(r)] = codes[r] + 1;
 
     // create a dataset
     auto features = shogun::some<shogun::CDenseFeatures<DataType>>(inputs);
@@ -69,7 +58,7 @@ int main(int argc, char** argv) {
     }
 
     auto labels =
-        shogun::wrap(new shogun::CMulticlassLabels(outputs.get_column(0)));
+        shogun::wrap(new shogun::CMulticlassLabels(outputs));
 
     std::cout << "labels num = " << labels->get_num_labels() << std::endl;
 
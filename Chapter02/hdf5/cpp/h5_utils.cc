@@ -0,0 +1,424 @@
+#include "h5_utils.h"
+
+#include <omp.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+H5Handle::H5Handle(hid_t id, CloseFn close, const std::string& what)
+    : id_(id), close_(close) {
+  if (id_ < 0)
+    throw std::runtime_error("HDF5 failed to " + what);
+}
+
+H5Handle::H5Handle(H5Handle&& other) noexcept
+    : id_(other.id_), close_(other.close_) {
+  other.id_ = -1;
+}
+
+H5Handle& H5Handle::operator=(H5Handle&& other) noexcept {
+  if (this != &other) {
+    if (id_ >= 0)
+      close_(id_);
+    id_ = other.id_;
+    close_ = other.close_;
+    other.id_ = -1;
+  }
+  return *this;
+}
+
+H5Handle::~H5Handle() {
+  if (id_ >= 0)
+    close_(id_);
+}
+
+void H5Check(herr_t status, const std::string& what) {
+  if (status < 0)
+    throw std::runtime_error("HDF5 failed to " + what);
+}
+
+template <>
+hid_t H5NativeType<char>() {
+  return H5T_NATIVE_CHAR;
+}
+
+template <>
+hid_t H5NativeType<int32_t>() {
+  return H5T_NATIVE_INT32;
+}
+
+template <>
+hid_t H5NativeType<uint32_t>() {
+  return H5T_NATIVE_UINT32;
+}
+
+template <>
+hid_t H5NativeType<uint64_t>() {
+  return H5T_NATIVE_UINT64;
+}
+
+template <typename T>
+H5AppendDataset<T>::H5AppendDataset(hid_t parent,
+                                    const std::string& name,
+                                    size_t cols,
+                                    const H5ChunkOptions& options)
+    : cols_(cols) {
+  const int rank = cols > 1 ? 2 : 1;
+  const auto row_bytes = cols * sizeof(T);
+  const auto chunk_rows = std::max<size_t>(1, options.chunk_bytes / row_bytes);
+  auto batch_rows = std::max<size_t>(1, options.batch_bytes / row_bytes);
+  batch_rows_ = (batch_rows + chunk_rows - 1) / chunk_rows * chunk_rows;
+  buffer_.reserve(batch_rows_ * cols);
+  hsize_t dims[2] = {0, cols};
+  hsize_t max_dims[2] = {H5S_UNLIMITED, cols};
+  hsize_t chunk[2] = {chunk_rows, cols};
+
+  H5Handle space(H5Screate_simple(rank, dims, max_dims), H5Sclose,
+                 "create the " + name + " dataspace");
+  H5Handle properties(H5Pcreate(H5P_DATASET_CREATE), H5Pclose,
+                      "create the " + name + " properties");
+  H5Check(H5Pset_chunk(properties.Get(), rank, chunk),
+          "set the " + name + " chunk");
+  if (options.shuffle)
+    H5Check(H5Pset_shuffle(properties.Get()), "set the " + name + " shuffle");
+  if (options.deflate_level > 0)
+    H5Check(H5Pset_deflate(properties.Get(), options.deflate_level),
+            "set the " + name + " deflate");
+  dataset_ = H5Handle(H5Dcreate2(parent, name.c_str(), H5NativeType<T>(),
+                                 space.Get(), H5P_DEFAULT, properties.Get(),
+                                 H5P_DEFAULT),
+                      H5Dclose, "create the " + name + " dataset");
+}
+
+template <typename T>
+void H5AppendDataset<T>::WriteRows(size_t rows) {
+  if (rows == 0)
+    return;
+  const int rank = cols_ > 1 ? 2 : 1;
+  hsize_t new_dims[2] = {rows_ + rows, cols_};
+  H5Check(H5Dset_extent(dataset_.Get(), new_dims), "extend a dataset");
+
+  hsize_t start[2] = {rows_, 0};
+  hsize_t count[2] = {rows, cols_};
+  H5Handle file_space(H5Dget_space(dataset_.Get()), H5Sclose,
+                      "get a dataset space");
+  H5Check(H5Sselect_hyperslab(file_space.Get(), H5S_SELECT_SET, start,
+                              nullptr, count, nullptr),
+          "select a hyperslab");
+  H5Handle memory_space(H5Screate_simple(rank, count, nullptr), H5Sclose,
+                        "create a memory space");
+  H5Check(H5Dwrite(dataset_.Get(), H5NativeType<T>(), memory_space.Get(),
+                   file_space.Get(), H5P_DEFAULT, buffer_.data()),
+          "write a hyperslab");
+  rows_ += rows;
+  buffer_.erase(buffer_.begin(),
+                buffer_.begin() + static_cast<ptrdiff_t>(rows * cols_));
+}
+
+namespace {
+H5Shape GetShape(hid_t dataset, const std::string& name) {
+  H5Handle space(H5Dget_space(dataset), H5Sclose,
+                 "get the " + name + " space");
+  const auto rank = H5Sget_simple_extent_ndims(space.Get());
+  hsize_t dims[2] = {0, 1};
+  if (rank < 1 || rank > 2 ||
+      H5Sget_simple_extent_dims(space.Get(), dims, nullptr) < 0)
+    throw std::runtime_error("Unsupported " + name + " dataset shape");
+  return H5Shape{static_cast<size_t>(dims[0]), static_cast<size_t>(dims[1])};
+}
+
+enum class ChunkFilter { Shuffle, Deflate };
+
+// Chunk size and filters of a dataset chunked along the rows, filters are
+// in the pipeline order; empty if chunks can not be decoded here
+struct ChunkLayout {
+  size_t chunk_rows{0};
+  std::vector<ChunkFilter> filters;
+};
+
+// Raw chunk bytes are used as memory values, so the stored type has to be
+// the memory type, other datasets are converted by H5Dread
+ChunkLayout GetChunkLayout(hid_t dataset,
+                           int rank,
+                           hsize_t cols,
+                           hid_t mem_type) {
+  H5Handle properties(H5Dget_create_plist(dataset), H5Pclose,
+                      "get the dataset properties");
+  if (H5Pget_layout(properties.Get()) != H5D_CHUNKED)
+    return {};
+  H5Handle type(H5Dget_type(dataset), H5Tclose, "get the dataset type");
+  if (H5Tequal(type.Get(), mem_type) <= 0)
+    return {};
+  hsize_t chunk[2] = {0, 1};
+  if (H5Pget_chunk(properties.Get(), 2, chunk) != rank ||
+      (rank == 2 && chunk[1] != cols))
+    return {};
+  ChunkLayout layout;
+  auto filters_num = H5Pget_nfilters(properties.Get());
+  for (int i = 0; i < filters_num; ++i) {
+    unsigned flags{0};
+    size_t values_num{0};
+    unsigned config{0};
+    auto filter = H5Pget_filter2(properties.Get(), static_cast<unsigned>(i),
+                                 &flags, &values_num, nullptr, 0, nullptr,
+                                 &config);
+    if (filter == H5Z_FILTER_DEFLATE) {
+      layout.filters.push_back(ChunkFilter::Deflate);
+    } else if (filter == H5Z_FILTER_SHUFFLE) {
+      layout.filters.push_back(ChunkFilter::Shuffle);
+    } else {
+      return {};
+    }
+  }
+  layout.chunk_rows = static_cast<size_t>(chunk[0]);
+  return layout;
+}
+
+// Inverse of the HDF5 shuffle filter, which stores the first bytes of all
+// elements, then the second bytes and so on
+void Unshuffle(const unsigned char* src,
+               size_t size,
+               size_t element_size,
+               unsigned char* dst) {
+  const auto elements = size / element_size;
+  for (size_t b = 0; b < element_size; ++b) {
+    const auto* plane = src + b * elements;
+    for (size_t i = 0; i < elements; ++i)
+      dst[i * element_size + b] = plane[i];
+  }
+  const auto tail = elements * element_size;
+  std::copy(src + tail, src + size, dst + tail);
+}
+
+// Applies the filters in the reverse pipeline order, skipping the ones
+// marked in the filter mask, and copies the decoded bytes to the destination
+bool DecodeChunk(const std::vector<unsigned char>& raw,
+                 uint32_t filter_mask,
+                 const std::vector<ChunkFilter>& filters,
+                 size_t element_size,
+                 size_t chunk_bytes,
+                 unsigned char* dst,
+                 size_t dst_bytes) {
+  thread_local std::vector<unsigned char> buffers[2];
+  const auto* data = raw.data();
+  auto size = raw.size();
+  size_t current = 0;
+  for (auto i = filters.size(); i-- > 0;) {
+    if (filter_mask & (1u << i))
+      continue;
+    auto& out = buffers[current];
+    current = 1 - current;
+    out.resize(chunk_bytes);
+    if (filters[i] == ChunkFilter::Deflate) {
+      uLongf out_size = chunk_bytes;
+      if (uncompress(out.data(), &out_size, data, size) != Z_OK)
+        return false;
+      size = out_size;
+    } else {
+      Unshuffle(data, size, element_size, out.data());
+    }
+    data = out.data();
+  }
+  if (size < dst_bytes)
+    return false;
+  std::copy_n(data, dst_bytes, dst);
+  return true;
+}
+
+// Chunks never written hold the fill value and have no raw data, such
+// datasets are read by H5Dread
+bool AllChunksAllocated(hid_t dataset, size_t rows, size_t chunk_rows) {
+  H5Handle space(H5Dget_space(dataset), H5Sclose, "get the dataset space");
+  hsize_t allocated{0};
+  H5Check(H5Dget_num_chunks(dataset, space.Get(), &allocated),
+          "get the number of chunks");
+  return allocated == (rows + chunk_rows - 1) / chunk_rows;
+}
+
+// Reads raw chunks with this thread and decodes them in OpenMP tasks
+void ReadChunksParallel(hid_t dataset,
+                        const ChunkLayout& layout,
+                        size_t rows,
+                        size_t row_bytes,
+                        size_t element_size,
+                        unsigned char* values,
+                        H5ReadStats& stats) {
+  const auto chunk_rows = layout.chunk_rows;
+  const auto chunks_num = (rows + chunk_rows - 1) / chunk_rows;
+  const auto chunk_bytes = chunk_rows * row_bytes;
+  // raw chunks waiting for decoding are limited to bound the memory use
+  const auto max_pending = static_cast<size_t>(omp_get_max_threads()) * 4;
+  std::atomic<size_t> pending{0};
+  std::atomic<bool> decode_failed{false};
+  std::string read_error;
+  size_t stored_bytes = 0;
+
+#pragma omp parallel
+#pragma omp single
+  {
+    for (size_t c = 0; c < chunks_num && read_error.empty(); ++c) {
+      hsize_t offset[2] = {c * chunk_rows, 0};
+      hsize_t size{0};
+      if (H5Dget_chunk_storage_size(dataset, offset, &size) < 0) {
+        read_error = "HDF5 failed to get a chunk size";
+        break;
+      }
+      auto* dst = values + c * chunk_bytes;
+      auto dst_bytes = std::min(chunk_rows, rows - c * chunk_rows) * row_bytes;
+      auto raw = std::make_shared<std::vector<unsigned char>>(size);
+      uint32_t filter_mask{0};
+      if (H5Dread_chunk(dataset, H5P_DEFAULT, offset, &filter_mask,
+                        raw->data()) < 0) {
+        read_error = "HDF5 failed to read a chunk";
+        break;
+      }
+      stored_bytes += size;
+      // with too many chunks pending this thread decodes the chunk itself,
+      // the task is executed immediately
+      bool deferred = pending.load() < max_pending;
+      if (deferred)
+        ++pending;
+#pragma omp task if (deferred) firstprivate(raw, filter_mask, dst, dst_bytes, \
+                                            deferred)
+      {
+        if (!DecodeChunk(*raw, filter_mask, layout.filters, element_size,
+                         chunk_bytes, dst, dst_bytes))
+          decode_failed = true;
+        if (deferred)
+          --pending;
+      }
+    }
+  }
+  if (!read_error.empty())
+    throw std::runtime_error(read_error);
+  if (decode_failed)
+    throw std::runtime_error("Failed to decode a HDF5 chunk");
+  stats.stored_bytes += stored_bytes;
+}
+}  // namespace
+
+H5Shape H5GetShape(hid_t parent, const std::string& name) {
+  H5Handle dataset(H5Dopen2(parent, name.c_str(), H5P_DEFAULT), H5Dclose,
+                   "open the " + name + " dataset");
+  return GetShape(dataset.Get(), name);
+}
+
+template <typename T>
+void H5ReadInto(hid_t parent,
+                const std::string& name,
+                T* values,
+                H5ReadStats* stats) {
+  auto start = std::chrono::steady_clock::now();
+  H5Handle dataset(H5Dopen2(parent, name.c_str(), H5P_DEFAULT), H5Dclose,
+                   "open the " + name + " dataset");
+  auto shape = GetShape(dataset.Get(), name);
+  H5ReadStats read_stats;
+  if (shape.Size() > 0) {
+    const int rank = shape.cols > 1 ? 2 : 1;
+    auto layout =
+        GetChunkLayout(dataset.Get(), rank, shape.cols, H5NativeType<T>());
+    if (layout.chunk_rows > 0 &&
+        AllChunksAllocated(dataset.Get(), shape.rows, layout.chunk_rows)) {
+      ReadChunksParallel(dataset.Get(), layout, shape.rows,
+                         shape.cols * sizeof(T), sizeof(T),
+                         reinterpret_cast<unsigned char*>(values), read_stats);
+    } else {
+      H5Check(H5Dread(dataset.Get(), H5NativeType<T>(), H5S_ALL, H5S_ALL,
+                      H5P_DEFAULT, values),
+              "read the " + name + " dataset");
+      read_stats.stored_bytes = H5Dget_storage_size(dataset.Get());
+    }
+  }
+  if (stats) {
+    std::chrono::duration<double> read_time =
+        std::chrono::steady_clock::now() - start;
+    read_stats.bytes = shape.Size() * sizeof(T);
+    read_stats.seconds = read_time.count();
+    stats->Add(read_stats);
+  }
+}
+
+template <typename T>
+std::vector<T> H5ReadAll(hid_t parent,
+                         const std::string& name,
+                         size_t* cols,
+                         H5ReadStats* stats) {
+  auto shape = H5GetShape(parent, name);
+  if (cols)
+    *cols = shape.cols;
+  std::vector<T> values(shape.Size());
+  H5ReadInto(parent, name, values.data(), stats);
+  return values;
+}
+
+template <typename T>
+H5MappedDataset<T>::H5MappedDataset(const std::string& file_name,
+                                    const std::string& name) {
+  hsize_t offset{0};
+  {
+    H5Handle file(H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT),
+                  H5Fclose, "open " + file_name);
+    H5Handle dataset(H5Dopen2(file.Get(), name.c_str(), H5P_DEFAULT),
+                     H5Dclose, "open the " + name + " dataset");
+    shape_ = GetShape(dataset.Get(), name);
+    H5Handle properties(H5Dget_create_plist(dataset.Get()), H5Pclose,
+                        "get the " + name + " properties");
+    H5Handle type(H5Dget_type(dataset.Get()), H5Tclose,
+                  "get the " + name + " type");
+    auto address = H5Dget_offset(dataset.Get());
+    if (H5Pget_layout(properties.Get()) != H5D_CONTIGUOUS ||
+        H5Tequal(type.Get(), H5NativeType<T>()) <= 0 || address == HADDR_UNDEF)
+      return;
+    // addresses are relative to the end of the user block
+    H5Handle file_properties(H5Fget_create_plist(file.Get()), H5Pclose,
+                             "get the " + file_name + " properties");
+    hsize_t user_block{0};
+    H5Check(H5Pget_userblock(file_properties.Get(), &user_block),
+            "get the " + file_name + " user block");
+    offset = user_block + address;
+  }
+  file_ = std::make_unique<csv::MappedFile>(file_name);
+  const auto bytes = shape_.Size() * sizeof(T);
+  if (!file_->IsOpen() || offset + bytes > file_->Size() ||
+      offset % alignof(T) != 0) {
+    file_.reset();
+    return;
+  }
+  data_ = reinterpret_cast<const T*>(file_->Data() + offset);
+}
+
+template class H5AppendDataset<char>;
+template class H5AppendDataset<int32_t>;
+template class H5AppendDataset<uint32_t>;
+template class H5AppendDataset<uint64_t>;
+
+template void H5ReadInto(hid_t, const std::string&, char*, H5ReadStats*);
+template void H5ReadInto(hid_t, const std::string&, int32_t*, H5ReadStats*);
+template void H5ReadInto(hid_t, const std::string&, uint32_t*, H5ReadStats*);
+template void H5ReadInto(hid_t, const std::string&, uint64_t*, H5ReadStats*);
+
+template std::vector<char> H5ReadAll(hid_t,
+                                     const std::string&,
+                                     size_t*,
+                                     H5ReadStats*);
+template std::vector<int32_t> H5ReadAll(hid_t,
+                                        const std::string&,
+                                        size_t*,
+                                        H5ReadStats*);
+template std::vector<uint32_t> H5ReadAll(hid_t,
+                                         const std::string&,
+                                         size_t*,
+                                         H5ReadStats*);
+template std::vector<uint64_t> H5ReadAll(hid_t,
+                                         const std::string&,
+                                         size_t*,
+                                         H5ReadStats*);
+
+template class H5MappedDataset<char>;
+template class H5MappedDataset<int32_t>;
+template class H5MappedDataset<uint32_t>;
+template class H5MappedDataset<uint64_t>;
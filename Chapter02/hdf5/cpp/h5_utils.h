@@ -0,0 +1,163 @@
+#ifndef H5_UTILS_H
+#define H5_UTILS_H
+
+#include "../../csv/common/mapped_file.h"
+
+#include <hdf5.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Owning HDF5 identifier, closed with the function matching its kind
+class H5Handle {
+ public:
+  using CloseFn = herr_t (*)(hid_t);
+
+  H5Handle() = default;
+  // Throws if the id is negative, the HDF5 failure code
+  H5Handle(hid_t id, CloseFn close, const std::string& what);
+  H5Handle(const H5Handle&) = delete;
+  H5Handle& operator=(const H5Handle&) = delete;
+  H5Handle(H5Handle&& other) noexcept;
+  H5Handle& operator=(H5Handle&& other) noexcept;
+  ~H5Handle();
+
+  hid_t Get() const { return id_; }
+
+ private:
+  hid_t id_{-1};
+  CloseFn close_{nullptr};
+};
+
+// Throws for negative HDF5 status codes
+void H5Check(herr_t status, const std::string& what);
+
+template <typename T>
+hid_t H5NativeType();
+template <>
+hid_t H5NativeType<char>();
+template <>
+hid_t H5NativeType<int32_t>();
+template <>
+hid_t H5NativeType<uint32_t>();
+template <>
+hid_t H5NativeType<uint64_t>();
+
+struct H5ChunkOptions {
+  // Chunks of 256 KB are small enough to give every thread several chunks
+  // to decode and large enough for deflate and for the read overhead.
+  size_t chunk_bytes{256 << 10};
+  size_t batch_bytes{4 << 20};  // buffered before a write
+  unsigned deflate_level{4};    // 0 - no compression
+  // Byte shuffle before deflate, groups the zero high bytes of small numbers
+  bool shuffle{true};
+};
+
+// Dataset of rows x cols elements which grows along the first dimension.
+// Rows are buffered and written in batches of whole chunks, every batch
+// extends the dataset and is written with one hyperslab write, so chunks are
+// compressed once. Single column datasets are one dimensional.
+template <typename T>
+class H5AppendDataset {
+ public:
+  H5AppendDataset(hid_t parent,
+                  const std::string& name,
+                  size_t cols,
+                  const H5ChunkOptions& options);
+
+  void Push(T value) {
+    buffer_.push_back(value);
+    if (buffer_.size() >= batch_rows_ * cols_)
+      WriteRows(buffer_.size() / cols_ / batch_rows_ * batch_rows_);
+  }
+
+  template <typename Iterator>
+  void Push(Iterator begin, Iterator end) {
+    buffer_.insert(buffer_.end(), begin, end);
+    if (buffer_.size() >= batch_rows_ * cols_)
+      WriteRows(buffer_.size() / cols_ / batch_rows_ * batch_rows_);
+  }
+
+  // Writes the buffered rows, the buffer must hold whole rows
+  void Flush() { WriteRows(buffer_.size() / cols_); }
+
+  // Written and buffered rows
+  size_t Rows() const { return rows_ + buffer_.size() / cols_; }
+
+ private:
+  // Writes the first rows of the buffer
+  void WriteRows(size_t rows);
+
+  H5Handle dataset_;
+  size_t cols_;
+  size_t rows_{0};
+  size_t batch_rows_;
+  std::vector<T> buffer_;
+};
+
+struct H5ReadStats {
+  size_t bytes{0};         // decoded bytes
+  size_t stored_bytes{0};  // bytes read from the file
+  double seconds{0};
+
+  void Add(const H5ReadStats& other) {
+    bytes += other.bytes;
+    stored_bytes += other.stored_bytes;
+    seconds += other.seconds;
+  }
+  double MBPerSecond() const { return seconds > 0 ? bytes / seconds / 1e6 : 0; }
+};
+
+struct H5Shape {
+  size_t rows{0};
+  size_t cols{0};  // 1 for one dimensional datasets
+  size_t Size() const { return rows * cols; }
+};
+
+// Shape of a one or two dimensional dataset
+H5Shape H5GetShape(hid_t parent, const std::string& name);
+
+// Whole dataset read straight into the caller buffer of H5GetShape().Size()
+// elements, e.g. Eigen, dlib matrix or torch tensor storage. Datasets of
+// the native type of T chunked along the rows and compressed with deflate
+// and shuffle filters are read in parallel: the calling thread reads raw
+// chunks with H5Dread_chunk while OpenMP tasks decode them into disjoint
+// parts of the buffer, so decompression overlaps with reading. Only one
+// thread calls HDF5, so the library does not need to be built thread safe.
+// Other datasets, e.g. of another byte order or element size, are read and
+// converted with one H5Dread.
+template <typename T>
+void H5ReadInto(hid_t parent,
+                const std::string& name,
+                T* values,
+                H5ReadStats* stats = nullptr);
+
+// Whole dataset read into a new vector, the number of elements in a row is
+// returned in cols if given
+template <typename T>
+std::vector<T> H5ReadAll(hid_t parent,
+                         const std::string& name,
+                         size_t* cols = nullptr,
+                         H5ReadStats* stats = nullptr);
+
+// Read-only memory mapping of a dataset stored contiguously, without
+// filters and in the native type, so its data is used in place without any
+// copy. Data() is nullptr if the dataset can not be mapped, e.g. when it is
+// chunked.
+template <typename T>
+class H5MappedDataset {
+ public:
+  H5MappedDataset(const std::string& file_name, const std::string& name);
+
+  const T* Data() const { return data_; }
+  const H5Shape& Shape() const { return shape_; }
+
+ private:
+  std::unique_ptr<csv::MappedFile> file_;
+  const T* data_{nullptr};
+  H5Shape shape_;
+};
+
+#endif  // H5_UTILS_H
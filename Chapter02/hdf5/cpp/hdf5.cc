@@ -1,8 +1,10 @@
 #include "../../json/cpp/reviewsreader.h"
+#include "reviews_store.h"
 
-#include <highfive/H5DataSet.hpp>
-#include <highfive/H5DataSpace.hpp>
-#include <highfive/H5File.hpp>
+#include <Eigen/Dense>
+
+#include <chrono>
+#include <iostream>
 
 const std::string file_name("reviews.h5");
 
@@ -11,73 +13,85 @@ const std::string file_name("reviews.h5");
 int main(int argc, char** argv) {
   try {
     if (argc > 1) {
-      auto papers = ReadPapersReviews(argv[1]);
-
-      // write dataset
+      // write dataset, papers are written while the json file is parsed, so
+      // the whole corpus is never held in memory
       {
-        HighFive::File file(file_name, HighFive::File::ReadWrite |
-                                           HighFive::File::Create |
-                                           HighFive::File::Truncate);
-
-        auto papers_group = file.createGroup("papers");
-        for (const auto& paper : papers) {
-          auto paper_group =
-              papers_group.createGroup("paper_" + std::to_string(paper.id));
-          std::vector<uint32_t> id = {paper.id};
-          auto id_attr = paper_group.createAttribute<uint32_t>(
-              "id", HighFive::DataSpace::From(id));
-
-          id_attr.write(id);
-          auto dec_attr = paper_group.createAttribute<std::string>(
-              "preliminary_decision",
-              HighFive::DataSpace::From(paper.preliminary_decision));
-          dec_attr.write(paper.preliminary_decision);
-          auto reviews_group = paper_group.createGroup("reviews");
-
-          std::vector<size_t> dims = {3};
-          std::vector<int32_t> values(3);
-          for (const auto& r : paper.reviews) {
-            auto dataset = reviews_group.createDataSet<int32_t>(
-                std::to_string(r.id), HighFive::DataSpace(dims));
-            values[0] = std::stoi(r.confidence);
-            values[1] = std::stoi(r.evaluation);
-            values[2] = std::stoi(r.orientation);
-            dataset.write(values);
-          }
-        }
+        auto start = std::chrono::steady_clock::now();
+        ReviewsStoreOptions options;
+        // contiguous scores can be memory mapped, but are held in memory
+        // until the file is closed
+        options.contiguous_scores =
+            argc > 2 && std::string(argv[2]) == "--map-scores";
+        ReviewsStoreWriter writer(file_name, options);
+        VisitPapersReviews(
+            argv[1], [&writer](const Paper& paper) { writer.Add(paper); });
+        writer.Close();
+        std::chrono::duration<double> write_time =
+            std::chrono::steady_clock::now() - start;
+        std::cerr << "Converted " << writer.PapersNum() << " papers and "
+                  << writer.ReviewsNum() << " reviews in "
+                  << write_time.count() << "s" << std::endl;
       }
       // read dataset
       {
-        HighFive::File file(file_name, HighFive::File::ReadOnly);
-        auto papers_group = file.getGroup("papers");
-        auto papers_names = papers_group.listObjectNames();
-        for (const auto& pname : papers_names) {
-          auto paper_group = papers_group.getGroup(pname);
-          std::vector<uint32_t> id;
-          paper_group.getAttribute("id").read(id);
-          std::cout << id[0];
-
-          std::string decision;
-          paper_group.getAttribute("preliminary_decision").read(decision);
-          std::cout << " " << decision << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        ReviewsStoreReader reader(file_name);
+        auto ids = reader.ReadPaperIds();
+        auto offsets = reader.ReadReviewOffsets();
+        auto decisions = reader.ReadStrings("papers/decision");
+        auto review_ids = reader.ReadReviewIds();
+        auto scores = reader.ReadScores();
+        auto texts = reader.ReadStrings("reviews/text");
+        std::chrono::duration<double> read_time =
+            std::chrono::steady_clock::now() - start;
+        const auto& stats = reader.GetReadStats();
+        std::cerr << "Read " << ids.size() << " papers and "
+                  << review_ids.size() << " reviews with " << texts.chars.size()
+                  << " text chars in " << read_time.count() << "s, "
+                  << stats.bytes / 1e6 << " MB decoded from "
+                  << stats.stored_bytes / 1e6 << " MB stored, "
+                  << stats.MBPerSecond() << " MB/s" << std::endl;
 
-          auto reviews_group = paper_group.getGroup("reviews");
-          auto reviews_names = reviews_group.listObjectNames();
-          std::vector<int32_t> values(2);
-          for (const auto& rname : reviews_names) {
-            std::cout << "\t review: " << rname << std::endl;
-            auto dataset = reviews_group.getDataSet(rname);
-            auto selection = dataset.select(
-                {1}, {2});  // or use just dataset.read method to get whole data
-            selection.read(values);
-            std::cout << "\t\t evaluation: " << values[0] << std::endl;
-            std::cout << "\t\t orientation: " << values[1] << std::endl;
+        for (size_t p = 0; p < ids.size(); ++p) {
+          std::cout << ids[p] << " " << decisions[p] << std::endl;
+          for (auto r = offsets[p]; r < offsets[p + 1]; ++r) {
+            std::cout << "\t review: " << review_ids[r] << std::endl;
+            std::cout << "\t\t evaluation: " << scores[r * kScoresCols + 1]
+                      << std::endl;
+            std::cout << "\t\t orientation: " << scores[r * kScoresCols + 2]
+                      << std::endl;
           }
         }
       }
+      // load scores as a features matrix
+      {
+        using Matrix = Eigen::Matrix<int32_t, Eigen::Dynamic,
+                                     static_cast<int>(kScoresCols),
+                                     Eigen::RowMajor>;
+        ReviewsStoreReader reader(file_name);
+        // zero copies: contiguous scores are used in place in the file mapping
+        auto mapped_scores = reader.MapScores();
+        if (mapped_scores.Data()) {
+          Eigen::Map<const Matrix> x_data(
+              mapped_scores.Data(),
+              static_cast<Eigen::Index>(mapped_scores.Shape().rows),
+              static_cast<Eigen::Index>(kScoresCols));
+          std::cout << "Mapped scores mean: "
+                    << x_data.cast<double>().colwise().mean() << std::endl;
+        } else {
+          std::cout << "Scores are chunked, use --map-scores to map them"
+                    << std::endl;
+        }
+        // one copy: scores are read straight into the matrix storage
+        Matrix x_data(static_cast<Eigen::Index>(reader.ReviewsNum()),
+                      static_cast<Eigen::Index>(kScoresCols));
+        reader.ReadScores(x_data.data());
+        std::cout << "Read scores mean: "
+                  << x_data.cast<double>().colwise().mean() << std::endl;
+      }
 
     } else {
-      std::cerr << "Please provide path to the dataset \n";
+      std::cerr << "Please provide path to the dataset [--map-scores]\n";
     }
   } catch (const std::exception& err) {
     std::cerr << err.what() << std::endl;
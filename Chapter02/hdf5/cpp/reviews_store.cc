@@ -0,0 +1,205 @@
+#include "reviews_store.h"
+
+#include <iostream>
+
+class ReviewsStoreWriter::StringTableWriter {
+ public:
+  StringTableWriter(hid_t parent,
+                    const std::string& name,
+                    const H5ChunkOptions& options)
+      : group_(H5Gcreate2(parent, name.c_str(), H5P_DEFAULT, H5P_DEFAULT,
+                          H5P_DEFAULT),
+               H5Gclose,
+               "create the " + name + " group"),
+        chars_(group_.Get(), "chars", 1, options),
+        offsets_(group_.Get(), "offsets", 1, options) {
+    offsets_.Push(0);
+  }
+
+  void Push(std::string_view value) {
+    chars_.Push(value.begin(), value.end());
+    size_ += value.size();
+    offsets_.Push(size_);
+  }
+
+  void Flush() {
+    chars_.Flush();
+    offsets_.Flush();
+  }
+
+ private:
+  H5Handle group_;
+  H5AppendDataset<char> chars_;
+  H5AppendDataset<uint64_t> offsets_;
+  uint64_t size_{0};
+};
+
+namespace {
+// Objects of 64 KB and more are aligned to pages, so mapped contiguous data
+// is aligned for any type
+H5Handle CreateFile(const std::string& file_name) {
+  H5Handle access(H5Pcreate(H5P_FILE_ACCESS), H5Pclose,
+                  "create the file access properties");
+  H5Check(H5Pset_alignment(access.Get(), 64 << 10, 4096),
+          "set the file alignment");
+  return H5Handle(
+      H5Fcreate(file_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, access.Get()),
+      H5Fclose, "create " + file_name);
+}
+}  // namespace
+
+ReviewsStoreWriter::ReviewsStoreWriter(const std::string& file_name,
+                                       const ReviewsStoreOptions& options)
+    : file_(CreateFile(file_name)),
+      papers_group_(H5Gcreate2(file_.Get(), "papers", H5P_DEFAULT,
+                               H5P_DEFAULT, H5P_DEFAULT),
+                    H5Gclose,
+                    "create the papers group"),
+      reviews_group_(H5Gcreate2(file_.Get(), "reviews", H5P_DEFAULT,
+                                H5P_DEFAULT, H5P_DEFAULT),
+                     H5Gclose,
+                     "create the reviews group") {
+  const auto papers = papers_group_.Get();
+  const auto reviews = reviews_group_.Get();
+  const auto& chunks = options.chunks;
+  contiguous_ = options.contiguous_scores;
+  paper_ids_ =
+      std::make_unique<H5AppendDataset<uint32_t>>(papers, "id", 1, chunks);
+  review_offsets_ = std::make_unique<H5AppendDataset<uint64_t>>(
+      papers, "review_offsets", 1, chunks);
+  review_offsets_->Push(0);
+  decisions_ = std::make_unique<StringTableWriter>(papers, "decision", chunks);
+  review_ids_ =
+      std::make_unique<H5AppendDataset<uint32_t>>(reviews, "id", 1, chunks);
+  if (!contiguous_)
+    scores_ = std::make_unique<H5AppendDataset<int32_t>>(reviews, "scores",
+                                                         kScoresCols, chunks);
+  languages_ =
+      std::make_unique<StringTableWriter>(reviews, "language", chunks);
+  remarks_ = std::make_unique<StringTableWriter>(reviews, "remarks", chunks);
+  texts_ = std::make_unique<StringTableWriter>(reviews, "text", chunks);
+  timespans_ =
+      std::make_unique<StringTableWriter>(reviews, "timespan", chunks);
+}
+
+void ReviewsStoreWriter::WriteContiguousScores() {
+  hsize_t dims[2] = {reviews_num_, kScoresCols};
+  H5Handle space(H5Screate_simple(2, dims, nullptr), H5Sclose,
+                 "create the scores dataspace");
+  H5Handle dataset(H5Dcreate2(reviews_group_.Get(), "scores", H5T_NATIVE_INT32,
+                              space.Get(), H5P_DEFAULT, H5P_DEFAULT,
+                              H5P_DEFAULT),
+                   H5Dclose, "create the scores dataset");
+  if (!contiguous_scores_.empty())
+    H5Check(H5Dwrite(dataset.Get(), H5T_NATIVE_INT32, H5S_ALL, H5S_ALL,
+                     H5P_DEFAULT, contiguous_scores_.data()),
+            "write the scores");
+  contiguous_scores_ = std::vector<int32_t>();
+}
+
+ReviewsStoreWriter::~ReviewsStoreWriter() {
+  try {
+    Close();
+  } catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+  }
+}
+
+void ReviewsStoreWriter::Add(const Paper& paper) {
+  paper_ids_->Push(paper.id);
+  decisions_->Push(paper.preliminary_decision);
+  for (const auto& review : paper.reviews) {
+    review_ids_->Push(review.id);
+    const int32_t scores[kScoresCols] = {ReviewScore(review.confidence),
+                                         ReviewScore(review.evaluation),
+                                         ReviewScore(review.orientation)};
+    if (contiguous_) {
+      contiguous_scores_.insert(contiguous_scores_.end(), scores,
+                                scores + kScoresCols);
+    } else {
+      scores_->Push(scores, scores + kScoresCols);
+    }
+    languages_->Push(review.language);
+    remarks_->Push(review.remarks);
+    texts_->Push(review.text);
+    timespans_->Push(review.timespan);
+  }
+  reviews_num_ += paper.reviews.size();
+  review_offsets_->Push(reviews_num_);
+  ++papers_num_;
+}
+
+void ReviewsStoreWriter::Close() {
+  if (file_.Get() < 0)
+    return;
+  paper_ids_->Flush();
+  review_offsets_->Flush();
+  decisions_->Flush();
+  review_ids_->Flush();
+  if (contiguous_) {
+    WriteContiguousScores();
+  } else {
+    scores_->Flush();
+  }
+  languages_->Flush();
+  remarks_->Flush();
+  texts_->Flush();
+  timespans_->Flush();
+  // datasets and groups have to be closed before the file
+  paper_ids_.reset();
+  review_offsets_.reset();
+  decisions_.reset();
+  review_ids_.reset();
+  scores_.reset();
+  languages_.reset();
+  remarks_.reset();
+  texts_.reset();
+  timespans_.reset();
+  papers_group_ = H5Handle();
+  reviews_group_ = H5Handle();
+  file_ = H5Handle();
+}
+
+ReviewsStoreReader::ReviewsStoreReader(const std::string& file_name)
+    : file_name_(file_name),
+      file_(H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT),
+            H5Fclose,
+            "open " + file_name) {}
+
+size_t ReviewsStoreReader::ReviewsNum() const {
+  return H5GetShape(file_.Get(), "reviews/id").rows;
+}
+
+std::vector<uint32_t> ReviewsStoreReader::ReadPaperIds() const {
+  return H5ReadAll<uint32_t>(file_.Get(), "papers/id", nullptr, &stats_);
+}
+
+std::vector<uint64_t> ReviewsStoreReader::ReadReviewOffsets() const {
+  return H5ReadAll<uint64_t>(file_.Get(), "papers/review_offsets", nullptr,
+                             &stats_);
+}
+
+std::vector<uint32_t> ReviewsStoreReader::ReadReviewIds() const {
+  return H5ReadAll<uint32_t>(file_.Get(), "reviews/id", nullptr, &stats_);
+}
+
+std::vector<int32_t> ReviewsStoreReader::ReadScores() const {
+  return H5ReadAll<int32_t>(file_.Get(), "reviews/scores", nullptr, &stats_);
+}
+
+void ReviewsStoreReader::ReadScores(int32_t* values) const {
+  H5ReadInto(file_.Get(), "reviews/scores", values, &stats_);
+}
+
+H5MappedDataset<int32_t> ReviewsStoreReader::MapScores() const {
+  return H5MappedDataset<int32_t>(file_name_, "reviews/scores");
+}
+
+StringTable ReviewsStoreReader::ReadStrings(const std::string& table) const {
+  StringTable strings;
+  strings.chars = H5ReadAll<char>(file_.Get(), table + "/chars", nullptr,
+                                  &stats_);
+  strings.offsets = H5ReadAll<uint64_t>(file_.Get(), table + "/offsets",
+                                        nullptr, &stats_);
+  return strings;
+}
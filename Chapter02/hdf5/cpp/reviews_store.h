@@ -0,0 +1,118 @@
+#ifndef REVIEWS_STORE_H
+#define REVIEWS_STORE_H
+
+#include "../../json/cpp/paper.h"
+#include "h5_utils.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Columnar HDF5 layout of the reviews corpus, P papers and R reviews:
+//   /papers/id              uint32 [P]
+//   /papers/review_offsets  uint64 [P + 1], reviews of the paper p are the
+//                           rows [offsets[p], offsets[p + 1]) of /reviews
+//   /papers/decision        string table
+//   /reviews/id             uint32 [R]
+//   /reviews/scores         int32 [R x 3]: confidence, evaluation, orientation
+//   /reviews/language, remarks, text, timespan - string tables
+// A string table is a group with the "chars" char [total length] dataset of
+// concatenated strings and the "offsets" uint64 [count + 1] dataset.
+// Datasets are chunked and grow along the rows, chunks are compressed with
+// the shuffle and deflate filters by default. On request the scores are
+// stored contiguously instead, so readers can memory map them.
+
+const size_t kScoresCols = 3;
+
+struct ReviewsStoreOptions {
+  H5ChunkOptions chunks;
+  // Scores are kept in memory, 12 bytes per review, and written on close as
+  // one uncompressed contiguous dataset aligned to a page in the file, so
+  // writer memory grows with the input. Off by default, scores are streamed
+  // to compressed chunks like the other datasets.
+  bool contiguous_scores{false};
+};
+
+// Appends papers to a new file, every dataset is written in large hyperslab
+// batches, so papers can be added straight from a streaming parser.
+class ReviewsStoreWriter {
+ public:
+  explicit ReviewsStoreWriter(const std::string& file_name,
+                              const ReviewsStoreOptions& options = {});
+  ~ReviewsStoreWriter();
+
+  void Add(const Paper& paper);
+
+  // Writes buffered data and closes the file
+  void Close();
+
+  size_t PapersNum() const { return papers_num_; }
+  size_t ReviewsNum() const { return reviews_num_; }
+
+ private:
+  class StringTableWriter;
+
+  void WriteContiguousScores();
+
+  H5Handle file_;
+  H5Handle papers_group_;
+  H5Handle reviews_group_;
+  std::unique_ptr<H5AppendDataset<uint32_t>> paper_ids_;
+  std::unique_ptr<H5AppendDataset<uint64_t>> review_offsets_;
+  std::unique_ptr<StringTableWriter> decisions_;
+  std::unique_ptr<H5AppendDataset<uint32_t>> review_ids_;
+  std::unique_ptr<H5AppendDataset<int32_t>> scores_;
+  std::vector<int32_t> contiguous_scores_;
+  bool contiguous_{false};
+  std::unique_ptr<StringTableWriter> languages_;
+  std::unique_ptr<StringTableWriter> remarks_;
+  std::unique_ptr<StringTableWriter> texts_;
+  std::unique_ptr<StringTableWriter> timespans_;
+  size_t papers_num_{0};
+  size_t reviews_num_{0};
+};
+
+struct StringTable {
+  std::vector<char> chars;
+  std::vector<uint64_t> offsets;
+
+  size_t Size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+  std::string_view operator[](size_t i) const {
+    return std::string_view(chars.data() + offsets[i],
+                            offsets[i + 1] - offsets[i]);
+  }
+};
+
+// Every method reads a whole dataset with one call, chunks are decoded in
+// parallel
+class ReviewsStoreReader {
+ public:
+  explicit ReviewsStoreReader(const std::string& file_name);
+
+  size_t ReviewsNum() const;
+
+  std::vector<uint32_t> ReadPaperIds() const;
+  std::vector<uint64_t> ReadReviewOffsets() const;
+  std::vector<uint32_t> ReadReviewIds() const;
+  // R x 3 row-major matrix
+  std::vector<int32_t> ReadScores() const;
+  // Scores read straight into a caller buffer of ReviewsNum() x 3 elements,
+  // e.g. the storage of a row-major matrix, without intermediate copies
+  void ReadScores(int32_t* values) const;
+  // Zero copy view of contiguously stored scores, Data() is nullptr for
+  // chunked ones
+  H5MappedDataset<int32_t> MapScores() const;
+  // Table path, e.g. "papers/decision" or "reviews/text"
+  StringTable ReadStrings(const std::string& table) const;
+
+  // Totals of all reads
+  const H5ReadStats& GetReadStats() const { return stats_; }
+
+ private:
+  std::string file_name_;
+  H5Handle file_;
+  mutable H5ReadStats stats_;
+};
+
+#endif  // REVIEWS_STORE_H
@@ -0,0 +1,371 @@
+#include "channels.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHANNELS_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define CHANNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace img {
+
+namespace {
+// Row kernels convert cols pixels starting at the given pixel index
+
+void RowToPlanesScalar(const uint8_t* src,
+                       size_t begin,
+                       size_t cols,
+                       uint8_t* const dst[3]) {
+  for (size_t i = begin; i < cols; ++i) {
+    dst[0][i] = src[3 * i];
+    dst[1][i] = src[3 * i + 1];
+    dst[2][i] = src[3 * i + 2];
+  }
+}
+
+void RowToPlanesScalar(const uint8_t* src,
+                       size_t begin,
+                       size_t cols,
+                       float* const dst[3],
+                       const ChannelTransform& t) {
+  for (int c = 0; c < 3; ++c) {
+    const uint8_t* channel = src + t.source[c];
+    for (size_t i = begin; i < cols; ++i)
+      dst[c][i] = channel[3 * i] * t.scale[c] + t.shift[c];
+  }
+}
+
+uint8_t Saturate(float value) {
+  // NaN compares false and becomes 0, like the SIMD max with zero
+  value = value > 0.f ? value : 0.f;
+  value = value < 255.f ? value : 255.f;
+  return static_cast<uint8_t>(std::nearbyint(value));
+}
+
+void RowToPixelsScalar(const float* const src[3],
+                       size_t begin,
+                       size_t cols,
+                       uint8_t* dst,
+                       float scale) {
+  for (size_t i = begin; i < cols; ++i) {
+    dst[3 * i] = Saturate(src[0][i] * scale);
+    dst[3 * i + 1] = Saturate(src[1][i] * scale);
+    dst[3 * i + 2] = Saturate(src[2][i] * scale);
+  }
+}
+
+#if defined(CHANNELS_X86)
+// pshufb masks: kGather[k][v] moves channel k bytes of the v-th 16 byte
+// part of 16 pixels to their place in a plane vector, kScatter[v][k] moves
+// plane k bytes to their place in the v-th 16 byte part of the pixels
+struct ShuffleMasks {
+  alignas(16) uint8_t gather[3][3][16];
+  alignas(16) uint8_t scatter[3][3][16];
+
+  ShuffleMasks() {
+    for (int k = 0; k < 3; ++k) {
+      for (int v = 0; v < 3; ++v) {
+        for (int j = 0; j < 16; ++j) {
+          int pos = 3 * j + k - 16 * v;
+          gather[k][v][j] = pos >= 0 && pos < 16 ? uint8_t(pos) : 0x80;
+          int g = 16 * v + j;
+          scatter[v][k][j] = g % 3 == k ? uint8_t(g / 3) : 0x80;
+        }
+      }
+    }
+  }
+};
+
+const ShuffleMasks kMasks;
+
+__attribute__((target("ssse3"))) inline __m128i Gather(const __m128i v[3],
+                                                       int k) {
+  auto mask = [k](int part) {
+    return _mm_load_si128(
+        reinterpret_cast<const __m128i*>(kMasks.gather[k][part]));
+  };
+  return _mm_or_si128(
+      _mm_or_si128(_mm_shuffle_epi8(v[0], mask(0)),
+                   _mm_shuffle_epi8(v[1], mask(1))),
+      _mm_shuffle_epi8(v[2], mask(2)));
+}
+
+__attribute__((target("ssse3"))) inline void Load(const uint8_t* src,
+                                                  __m128i v[3]) {
+  for (int part = 0; part < 3; ++part)
+    v[part] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + part);
+}
+
+__attribute__((target("ssse3"))) void RowToPlanesSsse3(
+    const uint8_t* src,
+    size_t cols,
+    uint8_t* const dst[3]) {
+  size_t i = 0;
+  for (; i + 16 <= cols; i += 16) {
+    __m128i v[3];
+    Load(src + 3 * i, v);
+    for (int k = 0; k < 3; ++k)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[k] + i), Gather(v, k));
+  }
+  RowToPlanesScalar(src, i, cols, dst);
+}
+
+__attribute__((target("ssse3"))) void RowToPlanesSsse3(
+    const uint8_t* src,
+    size_t cols,
+    float* const dst[3],
+    const ChannelTransform& t) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= cols; i += 16) {
+    __m128i v[3];
+    Load(src + 3 * i, v);
+    for (int c = 0; c < 3; ++c) {
+      const __m128 scale = _mm_set1_ps(t.scale[c]);
+      const __m128 shift = _mm_set1_ps(t.shift[c]);
+      __m128i bytes = Gather(v, t.source[c]);
+      __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero),
+                          _mm_unpackhi_epi8(bytes, zero)};
+      for (int w = 0; w < 2; ++w) {
+        __m128i ints[2] = {_mm_unpacklo_epi16(words[w], zero),
+                           _mm_unpackhi_epi16(words[w], zero)};
+        for (int n = 0; n < 2; ++n) {
+          __m128 values = _mm_add_ps(
+              _mm_mul_ps(_mm_cvtepi32_ps(ints[n]), scale), shift);
+          _mm_storeu_ps(dst[c] + i + 8 * w + 4 * n, values);
+        }
+      }
+    }
+  }
+  RowToPlanesScalar(src, i, cols, dst, t);
+}
+
+__attribute__((target("ssse3"))) void RowToPixelsSsse3(
+    const float* const src[3],
+    size_t cols,
+    uint8_t* dst,
+    float scale) {
+  const __m128 factor = _mm_set1_ps(scale);
+  const __m128 low = _mm_setzero_ps();
+  const __m128 high = _mm_set1_ps(255.f);
+  size_t i = 0;
+  for (; i + 16 <= cols; i += 16) {
+    __m128i planes[3];
+    for (int k = 0; k < 3; ++k) {
+      __m128i ints[4];
+      for (int n = 0; n < 4; ++n) {
+        __m128 values = _mm_mul_ps(_mm_loadu_ps(src[k] + i + 4 * n), factor);
+        // max first, it returns the second operand for NaN
+        values = _mm_min_ps(_mm_max_ps(values, low), high);
+        ints[n] = _mm_cvtps_epi32(values);
+      }
+      planes[k] = _mm_packus_epi16(_mm_packs_epi32(ints[0], ints[1]),
+                                   _mm_packs_epi32(ints[2], ints[3]));
+    }
+    for (int v = 0; v < 3; ++v) {
+      auto mask = [v](int k) {
+        return _mm_load_si128(
+            reinterpret_cast<const __m128i*>(kMasks.scatter[v][k]));
+      };
+      __m128i pixels = _mm_or_si128(
+          _mm_or_si128(_mm_shuffle_epi8(planes[0], mask(0)),
+                       _mm_shuffle_epi8(planes[1], mask(1))),
+          _mm_shuffle_epi8(planes[2], mask(2)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * i) + v, pixels);
+    }
+  }
+  RowToPixelsScalar(src, i, cols, dst, scale);
+}
+
+// Bytes are gathered with 128 bit shuffles, AVX2 shuffles do not cross
+// lanes, and widened to 8 floats at once
+__attribute__((target("avx2,fma"))) void RowToPlanesAvx2(
+    const uint8_t* src,
+    size_t cols,
+    float* const dst[3],
+    const ChannelTransform& t) {
+  size_t i = 0;
+  for (; i + 16 <= cols; i += 16) {
+    __m128i v[3];
+    Load(src + 3 * i, v);
+    for (int c = 0; c < 3; ++c) {
+      const __m256 scale = _mm256_set1_ps(t.scale[c]);
+      const __m256 shift = _mm256_set1_ps(t.shift[c]);
+      __m128i bytes = Gather(v, t.source[c]);
+      __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+      __m256 hi = _mm256_cvtepi32_ps(
+          _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+      _mm256_storeu_ps(dst[c] + i, _mm256_fmadd_ps(lo, scale, shift));
+      _mm256_storeu_ps(dst[c] + i + 8, _mm256_fmadd_ps(hi, scale, shift));
+    }
+  }
+  RowToPlanesScalar(src, i, cols, dst, t);
+}
+#endif  // CHANNELS_X86
+
+#if defined(CHANNELS_NEON)
+void RowToPlanesNeon(const uint8_t* src, size_t cols, uint8_t* const dst[3]) {
+  size_t i = 0;
+  for (; i + 16 <= cols; i += 16) {
+    uint8x16x3_t v = vld3q_u8(src + 3 * i);
+    vst1q_u8(dst[0] + i, v.val[0]);
+    vst1q_u8(dst[1] + i, v.val[1]);
+    vst1q_u8(dst[2] + i, v.val[2]);
+  }
+  RowToPlanesScalar(src, i, cols, dst);
+}
+
+void RowToPlanesNeon(const uint8_t* src,
+                     size_t cols,
+                     float* const dst[3],
+                     const ChannelTransform& t) {
+  size_t i = 0;
+  for (; i + 16 <= cols; i += 16) {
+    uint8x16x3_t v = vld3q_u8(src + 3 * i);
+    for (int c = 0; c < 3; ++c) {
+      const float32x4_t scale = vdupq_n_f32(t.scale[c]);
+      const float32x4_t shift = vdupq_n_f32(t.shift[c]);
+      uint8x16_t bytes = v.val[t.source[c]];
+      uint16x8_t words[2] = {vmovl_u8(vget_low_u8(bytes)),
+                             vmovl_u8(vget_high_u8(bytes))};
+      for (int w = 0; w < 2; ++w) {
+        uint32x4_t ints[2] = {vmovl_u16(vget_low_u16(words[w])),
+                              vmovl_u16(vget_high_u16(words[w]))};
+        for (int n = 0; n < 2; ++n) {
+          float32x4_t values =
+              vfmaq_f32(shift, vcvtq_f32_u32(ints[n]), scale);
+          vst1q_f32(dst[c] + i + 8 * w + 4 * n, values);
+        }
+      }
+    }
+  }
+  RowToPlanesScalar(src, i, cols, dst, t);
+}
+
+void RowToPixelsNeon(const float* const src[3],
+                     size_t cols,
+                     uint8_t* dst,
+                     float scale) {
+  const float32x4_t low = vdupq_n_f32(0.f);
+  const float32x4_t high = vdupq_n_f32(255.f);
+  size_t i = 0;
+  for (; i + 16 <= cols; i += 16) {
+    uint8x16x3_t pixels;
+    for (int k = 0; k < 3; ++k) {
+      uint16x4_t words[4];
+      for (int n = 0; n < 4; ++n) {
+        float32x4_t values = vmulq_n_f32(vld1q_f32(src[k] + i + 4 * n), scale);
+        // maxnm returns the number for NaN
+        values = vminq_f32(vmaxnmq_f32(values, low), high);
+        words[n] = vmovn_u32(vcvtnq_u32_f32(values));
+      }
+      pixels.val[k] =
+          vcombine_u8(vmovn_u16(vcombine_u16(words[0], words[1])),
+                      vmovn_u16(vcombine_u16(words[2], words[3])));
+    }
+    vst3q_u8(dst + 3 * i, pixels);
+  }
+  RowToPixelsScalar(src, i, cols, dst, scale);
+}
+#endif  // CHANNELS_NEON
+
+void RowToPlanesU8(const uint8_t* src, size_t cols, uint8_t* const dst[3]) {
+  RowToPlanesScalar(src, 0, cols, dst);
+}
+
+void RowToPlanesF32(const uint8_t* src,
+                    size_t cols,
+                    float* const dst[3],
+                    const ChannelTransform& t) {
+  RowToPlanesScalar(src, 0, cols, dst, t);
+}
+
+void RowToPixels(const float* const src[3],
+                 size_t cols,
+                 uint8_t* dst,
+                 float scale) {
+  RowToPixelsScalar(src, 0, cols, dst, scale);
+}
+
+struct Kernels {
+  const char* isa;
+  void (*to_planes_u8)(const uint8_t*, size_t, uint8_t* const[3]);
+  void (*to_planes_f32)(const uint8_t*,
+                        size_t,
+                        float* const[3],
+                        const ChannelTransform&);
+  void (*to_pixels)(const float* const[3], size_t, uint8_t*, float);
+};
+
+Kernels SelectKernels() {
+#if defined(CHANNELS_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return {"avx2", RowToPlanesSsse3, RowToPlanesAvx2, RowToPixelsSsse3};
+  if (__builtin_cpu_supports("ssse3"))
+    return {"ssse3", RowToPlanesSsse3, RowToPlanesSsse3, RowToPixelsSsse3};
+#elif defined(CHANNELS_NEON)
+  return {"neon", RowToPlanesNeon, RowToPlanesNeon, RowToPixelsNeon};
+#endif
+  return {"scalar", RowToPlanesU8, RowToPlanesF32, RowToPixels};
+}
+
+const Kernels& GetKernels() {
+  static const Kernels kernels = SelectKernels();
+  return kernels;
+}
+}  // namespace
+
+void HwcToChw(const uint8_t* src,
+              size_t src_step,
+              size_t rows,
+              size_t cols,
+              uint8_t* dst) {
+  const auto& kernels = GetKernels();
+  const size_t plane_size = rows * cols;
+  for (size_t r = 0; r < rows; ++r) {
+    uint8_t* const planes[3] = {dst + r * cols, dst + plane_size + r * cols,
+                                dst + 2 * plane_size + r * cols};
+    kernels.to_planes_u8(src + r * src_step, cols, planes);
+  }
+}
+
+void HwcToChw(const uint8_t* src,
+              size_t src_step,
+              size_t rows,
+              size_t cols,
+              float* dst,
+              const ChannelTransform& transform) {
+  const auto& kernels = GetKernels();
+  const size_t plane_size = rows * cols;
+  for (size_t r = 0; r < rows; ++r) {
+    float* const planes[3] = {dst + r * cols, dst + plane_size + r * cols,
+                              dst + 2 * plane_size + r * cols};
+    kernels.to_planes_f32(src + r * src_step, cols, planes, transform);
+  }
+}
+
+void ChwToHwc(const float* src,
+              size_t rows,
+              size_t cols,
+              uint8_t* dst,
+              size_t dst_step,
+              float scale) {
+  const auto& kernels = GetKernels();
+  const size_t plane_size = rows * cols;
+  for (size_t r = 0; r < rows; ++r) {
+    const float* const planes[3] = {src + r * cols,
+                                    src + plane_size + r * cols,
+                                    src + 2 * plane_size + r * cols};
+    kernels.to_pixels(planes, cols, dst + r * dst_step, scale);
+  }
+}
+
+const char* ChannelKernelsIsa() {
+  return GetKernels().isa;
+}
+
+}  // namespace img
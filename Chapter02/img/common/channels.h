@@ -0,0 +1,53 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace img {
+
+// Affine map of 8 bit pixel channels to float planes:
+//   plane[c] = pixel[source[c]] * scale[c] + shift[c]
+// e.g. source {2, 1, 0} turns BGR pixels into RGB planes, and
+// scale = 1 / (255 * std), shift = -mean / std normalizes the values.
+struct ChannelTransform {
+  int source[3]{0, 1, 2};
+  float scale[3]{1, 1, 1};
+  float shift[3]{0, 0, 0};
+};
+
+// Conversions of 3 channel images between interleaved pixels (HWC) and
+// channel planes (CHW). Pixel rows are step bytes apart, so padded rows and
+// image regions are handled in place; planes are dense, rows * cols
+// elements each, one after another. SSSE3 and AVX2 kernels are selected at
+// run time on x86, NEON kernels are used on AArch64, other targets and row
+// tails use scalar code.
+
+void HwcToChw(const uint8_t* src,
+              size_t src_step,
+              size_t rows,
+              size_t cols,
+              uint8_t* dst);
+
+void HwcToChw(const uint8_t* src,
+              size_t src_step,
+              size_t rows,
+              size_t cols,
+              float* dst,
+              const ChannelTransform& transform = {});
+
+// pixel[c] = plane[c] * scale rounded to nearest and saturated to 0..255
+void ChwToHwc(const float* src,
+              size_t rows,
+              size_t cols,
+              uint8_t* dst,
+              size_t dst_step,
+              float scale = 1);
+
+// Instruction set of the selected kernels: "avx2", "ssse3", "neon" or
+// "scalar"
+const char* ChannelKernelsIsa();
+
+}  // namespace img
+
+#endif  // CHANNELS_H
@@ -0,0 +1,195 @@
+#include "image_shard.h"
+
+#include <sys/mman.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace img {
+
+namespace {
+const char kMagic[8] = {'I', 'M', 'G', 'S', 'H', 'R', 'D', '1'};
+const uint64_t kAlignment = 64;
+
+struct ShardHeader {
+  char magic[8];
+  uint32_t type;
+  uint32_t channels;
+  uint32_t rows;
+  uint32_t cols;
+  uint64_t count;
+  uint64_t index_offset;
+  uint64_t file_size;
+};
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+void Pad(std::ofstream& out, uint64_t size) {
+  static const char zeros[kAlignment] = {};
+  out.write(zeros, static_cast<std::streamsize>(Align(size) - size));
+}
+
+bool operator==(const ShardInfo& a, const ShardInfo& b) {
+  return a.type == b.type && a.channels == b.channels && a.rows == b.rows &&
+         a.cols == b.cols;
+}
+}  // namespace
+
+size_t ShardInfo::RecordSize() const {
+  size_t element_size = 0;
+  switch (type) {
+    case RecordType::Uint8:
+      element_size = 1;
+      break;
+    case RecordType::Float32:
+      element_size = sizeof(float);
+      break;
+    case RecordType::Encoded:
+      break;
+  }
+  return element_size * channels * rows * cols;
+}
+
+std::string ShardFileName(const std::string& prefix, size_t shard) {
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), "-%05zu.shard", shard);
+  return prefix + suffix;
+}
+
+ImageShardWriter::ImageShardWriter(const std::string& prefix,
+                                   const ShardInfo& info,
+                                   size_t max_shard_bytes)
+    : prefix_(prefix), info_(info), max_shard_bytes_(max_shard_bytes) {
+  if (info_.type != RecordType::Encoded && info_.RecordSize() == 0)
+    throw std::invalid_argument("Empty tensor shape of shard records");
+}
+
+ImageShardWriter::~ImageShardWriter() {
+  try {
+    Close();
+  } catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+  }
+}
+
+void ImageShardWriter::Add(const void* data, size_t size, int64_t label) {
+  if (info_.type != RecordType::Encoded && size != info_.RecordSize())
+    throw std::invalid_argument("Wrong size of a tensor shard record");
+  if (!out_.is_open()) {
+    OpenShard();
+  } else if (!index_.empty() && offset_ + size > max_shard_bytes_) {
+    CloseShard();
+    OpenShard();
+  }
+  out_.write(static_cast<const char*>(data),
+             static_cast<std::streamsize>(size));
+  Pad(out_, size);
+  index_.push_back({offset_, size, label});
+  offset_ += Align(size);
+  ++count_;
+}
+
+void ImageShardWriter::Close() {
+  // an empty set still has a shard, so readers find it
+  if (!out_.is_open() && shard_ == 0)
+    OpenShard();
+  if (out_.is_open()) {
+    CloseShard();
+    // shards left from a previous larger set
+    for (auto n = shard_; std::remove(ShardFileName(prefix_, n).c_str()) == 0;
+         ++n) {
+    }
+  }
+}
+
+void ImageShardWriter::OpenShard() {
+  temp_name_ = ShardFileName(prefix_, shard_) + ".tmp";
+  out_.open(temp_name_, std::ios::binary | std::ios::trunc);
+  if (!out_)
+    throw std::runtime_error("Failed to create " + temp_name_);
+  ShardHeader header{};
+  out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  Pad(out_, sizeof(header));
+  offset_ = Align(sizeof(header));
+  index_.clear();
+}
+
+void ImageShardWriter::CloseShard() {
+  ShardHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.type = static_cast<uint32_t>(info_.type);
+  header.channels = info_.channels;
+  header.rows = info_.rows;
+  header.cols = info_.cols;
+  header.count = index_.size();
+  header.index_offset = offset_;
+  const auto index_size = index_.size() * sizeof(ShardIndexEntry);
+  out_.write(reinterpret_cast<const char*>(index_.data()),
+             static_cast<std::streamsize>(index_size));
+  header.file_size = static_cast<uint64_t>(out_.tellp());
+  out_.seekp(0);
+  out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out_.close();
+  auto file_name = ShardFileName(prefix_, shard_);
+  if (!out_ || std::rename(temp_name_.c_str(), file_name.c_str()) != 0) {
+    std::remove(temp_name_.c_str());
+    throw std::runtime_error("Failed to write " + file_name);
+  }
+  ++shard_;
+}
+
+ImageShards::ImageShards(const std::string& prefix) {
+  for (size_t n = 0;; ++n) {
+    auto file_name = ShardFileName(prefix, n);
+    auto file = std::make_unique<csv::MappedFile>(file_name);
+    if (!file->IsOpen()) {
+      if (n == 0)
+        throw std::runtime_error("Failed to open " + file_name);
+      break;
+    }
+    const auto* data = file->Data();
+    const auto size = file->Size();
+    ShardHeader header;
+    if (!data || size < sizeof(header))
+      throw std::runtime_error("Invalid shard " + file_name);
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.file_size != size || header.index_offset > size ||
+        (size - header.index_offset) / sizeof(ShardIndexEntry) < header.count)
+      throw std::runtime_error("Invalid shard " + file_name);
+    if (header.type > static_cast<uint32_t>(RecordType::Encoded))
+      throw std::runtime_error("Unknown record type in shard " + file_name);
+    ShardInfo info{static_cast<RecordType>(header.type), header.channels,
+                   header.rows, header.cols};
+    const auto record_size = info.RecordSize();
+    if (info.type != RecordType::Encoded && record_size == 0)
+      throw std::runtime_error("Empty tensor shape in shard " + file_name);
+    if (n == 0) {
+      info_ = info;
+    } else if (!(info == info_)) {
+      throw std::runtime_error("Shard " + file_name +
+                               " has another record type or shape");
+    }
+    // the mapping is page aligned, so is the index
+    const auto* index = reinterpret_cast<const ShardIndexEntry*>(
+        data + header.index_offset);
+    for (uint64_t i = 0; i < header.count; ++i) {
+      if (index[i].offset > header.index_offset ||
+          index[i].size > header.index_offset - index[i].offset ||
+          (record_size > 0 && index[i].size != record_size))
+        throw std::runtime_error("Invalid shard " + file_name);
+      samples_.push_back(
+          {reinterpret_cast<const uint8_t*>(data + index[i].offset),
+           index[i].size, index[i].label});
+    }
+    // samples are read in the shuffled order, read-ahead would be wasted
+    madvise(const_cast<char*>(data), size, MADV_RANDOM);
+    files_.push_back(std::move(file));
+  }
+}
+
+}  // namespace img
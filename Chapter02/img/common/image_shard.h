@@ -0,0 +1,100 @@
+#ifndef IMAGE_SHARD_H
+#define IMAGE_SHARD_H
+
+#include "../../csv/common/mapped_file.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace img {
+
+// Records are preprocessed tensors of one shape, or encoded (e.g. JPEG or
+// PNG) file bytes of any size to be decoded by the consumer
+enum class RecordType : uint32_t { Uint8 = 0, Float32 = 1, Encoded = 2 };
+
+struct ShardInfo {
+  RecordType type{RecordType::Uint8};
+  // tensor shape, channels first, zeros for encoded records
+  uint32_t channels{0};
+  uint32_t rows{0};
+  uint32_t cols{0};
+
+  // Bytes of a tensor record, 0 for encoded ones
+  size_t RecordSize() const;
+};
+
+// Index entry of a record in a shard
+struct ShardIndexEntry {
+  uint64_t offset;  // from the shard beginning
+  uint64_t size;
+  int64_t label;
+};
+
+// Training samples are stored in shard files "<prefix>-00000.shard",
+// "<prefix>-00001.shard", ... Every shard is a header, 64-byte aligned
+// records and, at the end, the index of record offsets, sizes and labels.
+// A shard is written to a temporary file and renamed when complete.
+class ImageShardWriter {
+ public:
+  ImageShardWriter(const std::string& prefix,
+                   const ShardInfo& info,
+                   size_t max_shard_bytes = size_t(1) << 30);
+  ~ImageShardWriter();
+  ImageShardWriter(const ImageShardWriter&) = delete;
+  ImageShardWriter& operator=(const ImageShardWriter&) = delete;
+
+  // Tensor records must have RecordSize() bytes
+  void Add(const void* data, size_t size, int64_t label);
+
+  // Finishes the last shard
+  void Close();
+
+  size_t Count() const { return count_; }
+  size_t Shards() const { return shard_ + (out_.is_open() ? 1 : 0); }
+
+ private:
+  void OpenShard();
+  void CloseShard();
+
+  std::string prefix_;
+  ShardInfo info_;
+  size_t max_shard_bytes_;
+  size_t shard_{0};
+  size_t count_{0};
+  std::ofstream out_;
+  std::string temp_name_;
+  uint64_t offset_{0};
+  std::vector<ShardIndexEntry> index_;
+};
+
+struct Sample {
+  const uint8_t* data{nullptr};
+  size_t size{0};
+  int64_t label{0};
+};
+
+// All shards of the prefix memory mapped for random access. Samples point
+// into the mappings, so getting one makes no system calls and copies
+// nothing, pages are read by the kernel on first access.
+class ImageShards {
+ public:
+  explicit ImageShards(const std::string& prefix);
+
+  size_t Size() const { return samples_.size(); }
+  const ShardInfo& Info() const { return info_; }
+  const Sample& Get(size_t index) const { return samples_[index]; }
+
+ private:
+  ShardInfo info_;
+  std::vector<std::unique_ptr<csv::MappedFile>> files_;
+  std::vector<Sample> samples_;
+};
+
+std::string ShardFileName(const std::string& prefix, size_t shard);
+
+}  // namespace img
+
+#endif  // IMAGE_SHARD_H
@@ -2,6 +2,10 @@
 #include <dlib/image_io.h>
 #include <dlib/image_transforms.h>
 
+#include "../common/channels.h"
+
+#include <algorithm>
+#include <chrono>
 #include <experimental/filesystem>
 #include <iostream>
 
@@ -101,12 +105,13 @@ int main(int argc, char** argv) {
     // but we can access raw data with image_data function and get row padding
     // with width_step. Pixels stored in row major order with interleaved
     // channels or do simple loop over all pixels
-    array2d<rgb_pixel> rgb_img(5, 5);
+    array2d<rgb_pixel> rgb_img(1080, 1920);
     assign_all_pixels(rgb_img, rgb_pixel(255, 128, 64));
     auto channel_size = static_cast<size_t>(rgb_img.nc() * rgb_img.nr());
     std::vector<unsigned char> ch1(channel_size);
     std::vector<unsigned char> ch2(channel_size);
     std::vector<unsigned char> ch3(channel_size);
+    auto start = std::chrono::steady_clock::now();
     size_t i{0};
     for (long r = 0; r < rgb_img.nr(); ++r) {
       for (long c = 0; c < rgb_img.nc(); ++c) {
@@ -116,6 +121,38 @@ int main(int argc, char** argv) {
         ++i;
       }
     }
+    std::chrono::duration<double, std::milli> loop_time =
+        std::chrono::steady_clock::now() - start;
+
+    // Vectorized kernels write all planes to one buffer in the CHW layout
+    // used by DL frameworks, optionally converting values to floats
+    const auto* pixels = static_cast<const uint8_t*>(image_data(rgb_img));
+    const auto step = static_cast<size_t>(width_step(rgb_img));
+    const auto rows = static_cast<size_t>(rgb_img.nr());
+    const auto cols = static_cast<size_t>(rgb_img.nc());
+    std::vector<unsigned char> planes(channel_size * 3);
+    start = std::chrono::steady_clock::now();
+    img::HwcToChw(pixels, step, rows, cols, planes.data());
+    std::chrono::duration<double, std::milli> kernel_time =
+        std::chrono::steady_clock::now() - start;
+
+    std::vector<float> tensor(channel_size * 3);
+    const float to_unit = 1.f / 255;
+    start = std::chrono::steady_clock::now();
+    img::HwcToChw(pixels, step, rows, cols, tensor.data(),
+                  {{0, 1, 2}, {to_unit, to_unit, to_unit}, {}});
+    std::chrono::duration<double, std::milli> float_kernel_time =
+        std::chrono::steady_clock::now() - start;
+
+    auto plane = [&](size_t c) { return planes.begin() + c * channel_size; };
+    bool same = std::equal(ch1.begin(), ch1.end(), plane(0)) &&
+                std::equal(ch2.begin(), ch2.end(), plane(1)) &&
+                std::equal(ch3.begin(), ch3.end(), plane(2));
+    std::cout << "Channels split: loop " << loop_time.count() << " ms, "
+              << img::ChannelKernelsIsa() << " kernel "
+              << kernel_time.count() << " ms, to float "
+              << float_kernel_time.count() << " ms, same planes " << same
+              << std::endl;
   } catch (const std::exception& err) {
     std::cerr << err.what();
   }
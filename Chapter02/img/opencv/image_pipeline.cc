@@ -0,0 +1,209 @@
+#include "image_pipeline.h"
+#include "../common/channels.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <experimental/filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::experimental::filesystem;
+
+namespace {
+const char kTensorMagic[8] = {'I', 'M', 'G', 'T', 'N', 'S', 'R', '1'};
+const uint64_t kDataAlignment = 64;
+
+// Converts the image to float and writes its channels as consecutive planes
+bool ToTensor(const cv::Mat& img,
+              const TensorShape& shape,
+              double scale,
+              float* tensor) {
+  if (img.channels() != shape.channels || img.rows != shape.rows ||
+      img.cols != shape.cols)
+    return false;
+  if (img.type() == CV_8UC3) {
+    // one pass conversion, without the intermediate float image
+    const auto factor = static_cast<float>(scale);
+    img::ChannelTransform transform{{0, 1, 2}, {factor, factor, factor}, {}};
+    img::HwcToChw(img.ptr<uint8_t>(), img.step, static_cast<size_t>(img.rows),
+                  static_cast<size_t>(img.cols), tensor, transform);
+    return true;
+  }
+  thread_local cv::Mat converted;
+  img.convertTo(converted, CV_32F, scale);
+  // plane headers over the tensor memory, so split does not allocate
+  std::vector<cv::Mat> planes;
+  const auto plane_size = static_cast<size_t>(shape.rows) * shape.cols;
+  for (int c = 0; c < shape.channels; ++c)
+    planes.emplace_back(shape.rows, shape.cols, CV_32FC1,
+                        tensor + plane_size * static_cast<size_t>(c));
+  cv::split(converted, planes);
+  return true;
+}
+}  // namespace
+
+ImagePipeline& ImagePipeline::Resize(cv::Size size, int interpolation) {
+  return Add([size, interpolation](const cv::Mat& src, cv::Mat& dst) {
+    cv::resize(src, dst, size, 0, 0, interpolation);
+  });
+}
+
+ImagePipeline& ImagePipeline::Scale(double factor, int interpolation) {
+  return Add([factor, interpolation](const cv::Mat& src, cv::Mat& dst) {
+    cv::resize(src, dst, {}, factor, factor, interpolation);
+  });
+}
+
+ImagePipeline& ImagePipeline::Crop(cv::Rect rect) {
+  return Add([rect](const cv::Mat& src, cv::Mat& dst) {
+    // the region is copied, a header would share the other scratch image
+    src(rect & cv::Rect(0, 0, src.cols, src.rows)).copyTo(dst);
+  });
+}
+
+ImagePipeline& ImagePipeline::CropFraction(double width, double height) {
+  return Add([width, height](const cv::Mat& src, cv::Mat& dst) {
+    src(cv::Rect(0, 0, static_cast<int>(src.cols * width),
+                 static_cast<int>(src.rows * height)))
+        .copyTo(dst);
+  });
+}
+
+ImagePipeline& ImagePipeline::Translate(double dx, double dy) {
+  cv::Mat trm = (cv::Mat_<double>(2, 3) << 1, 0, dx, 0, 1, dy);
+  return Add([trm](const cv::Mat& src, cv::Mat& dst) {
+    cv::warpAffine(src, dst, trm, src.size());
+  });
+}
+
+ImagePipeline& ImagePipeline::Rotate(double angle, double scale) {
+  return Add([angle, scale](const cv::Mat& src, cv::Mat& dst) {
+    auto rotm = cv::getRotationMatrix2D(
+        cv::Point2f(src.cols / 2.f, src.rows / 2.f), angle, scale);
+    cv::warpAffine(src, dst, rotm, src.size());
+  });
+}
+
+ImagePipeline& ImagePipeline::Pad(int top,
+                                  int bottom,
+                                  int left,
+                                  int right,
+                                  cv::Scalar value,
+                                  int border) {
+  return Add([=](const cv::Mat& src, cv::Mat& dst) {
+    cv::copyMakeBorder(src, dst, top, bottom, left, right, border, value);
+  });
+}
+
+ImagePipeline& ImagePipeline::CvtColor(int code) {
+  return Add([code](const cv::Mat& src, cv::Mat& dst) {
+    cv::cvtColor(src, dst, code);
+  });
+}
+
+ImagePipeline& ImagePipeline::Add(Op op) {
+  ops_.push_back(std::move(op));
+  return *this;
+}
+
+const cv::Mat& ImagePipeline::Apply(const cv::Mat& img) const {
+  thread_local cv::Mat scratch[2];
+  const cv::Mat* src = &img;
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    auto& dst = scratch[i % 2];
+    ops_[i](*src, dst);
+    src = &dst;
+  }
+  return *src;
+}
+
+PipelineStats ImagePipeline::Run(const std::vector<std::string>& file_names,
+                                 const std::string& output_file_name,
+                                 const TensorShape& shape,
+                                 double scale,
+                                 size_t batch_size) const {
+  auto start = std::chrono::steady_clock::now();
+  std::ofstream out(output_file_name, std::ios::binary | std::ios::trunc);
+  if (!out)
+    throw std::runtime_error("Failed to create " + output_file_name);
+  TensorFileHeader header{};
+  std::memcpy(header.magic, kTensorMagic, sizeof(kTensorMagic));
+  header.channels = static_cast<uint32_t>(shape.channels);
+  header.rows = static_cast<uint32_t>(shape.rows);
+  header.cols = static_cast<uint32_t>(shape.cols);
+  header.count = file_names.size();
+  header.data_offset = (sizeof(header) + kDataAlignment - 1) /
+                       kDataAlignment * kDataAlignment;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  const char zeros[kDataAlignment] = {};
+  out.write(zeros,
+            static_cast<std::streamsize>(header.data_offset - sizeof(header)));
+
+  PipelineStats stats;
+  const size_t image_size = shape.Size();
+  batch_size = std::max<size_t>(batch_size, 1);
+  std::vector<float> batch(batch_size * image_size);
+  for (size_t first = 0; first < file_names.size(); first += batch_size) {
+    const auto count = std::min(batch_size, file_names.size() - first);
+    size_t failed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : failed)
+    for (size_t i = 0; i < count; ++i) {
+      thread_local cv::Mat decoded;
+      float* tensor = batch.data() + i * image_size;
+      bool done = false;
+      try {
+        done = DecodeImage(file_names[first + i], decoded) &&
+               ToTensor(Apply(decoded), shape, scale, tensor);
+      } catch (const std::exception&) {
+        done = false;
+      }
+      if (!done) {
+        std::fill(tensor, tensor + image_size, 0.f);
+        ++failed;
+      }
+    }
+    out.write(reinterpret_cast<const char*>(batch.data()),
+              static_cast<std::streamsize>(count * image_size * sizeof(float)));
+    stats.images += count;
+    stats.failed += failed;
+  }
+  out.close();
+  if (!out)
+    throw std::runtime_error("Failed to write " + output_file_name);
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  stats.seconds = seconds.count();
+  return stats;
+}
+
+bool DecodeImage(const std::string& file_name, cv::Mat& img) {
+  thread_local std::vector<uchar> bytes;
+  std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+  if (!file)
+    return false;
+  auto size = static_cast<std::streamsize>(file.tellg());
+  if (size <= 0)
+    return false;
+  bytes.resize(static_cast<size_t>(size));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char*>(bytes.data()), size))
+    return false;
+  // imdecode leaves the destination unchanged when it fails, so the image of
+  // the previous file is released first
+  img.release();
+  cv::imdecode(bytes, cv::IMREAD_COLOR, &img);
+  return !img.empty();
+}
+
+std::vector<std::string> ListImageFiles(const std::string& dir_name) {
+  std::vector<std::string> file_names;
+  for (auto& entry : fs::directory_iterator(dir_name)) {
+    if (fs::is_regular_file(entry.status()))
+      file_names.push_back(entry.path().string());
+  }
+  std::sort(file_names.begin(), file_names.end());
+  return file_names;
+}
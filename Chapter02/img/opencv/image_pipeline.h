@@ -0,0 +1,92 @@
+#ifndef IMAGE_PIPELINE_H
+#define IMAGE_PIPELINE_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Shape of one image in the output tensor, channels first
+struct TensorShape {
+  int channels{3};
+  int rows{0};
+  int cols{0};
+  size_t Size() const { return size_t(channels) * size_t(rows) * cols; }
+};
+
+// Packed tensor file: the header, then count x channels x rows x cols float
+// values starting at data_offset, images in the order of the input files
+struct TensorFileHeader {
+  char magic[8];  // "IMGTNSR1"
+  uint32_t channels;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t data_offset;
+};
+
+struct PipelineStats {
+  size_t images{0};
+  size_t failed{0};  // not decoded or of another shape, stored as zeros
+  double seconds{0};
+  double ImagesPerSecond() const { return seconds > 0 ? images / seconds : 0; }
+};
+
+// Chain of image transformations applied without any GUI. Every operation
+// reads the source image and writes the destination one, the pipeline
+// alternates two per-thread scratch images between the operations, so after
+// the first images no memory is allocated for images of the same size.
+class ImagePipeline {
+ public:
+  using Op = std::function<void(const cv::Mat& src, cv::Mat& dst)>;
+
+  // use cv::INTER_AREA for shrinking and cv::INTER_CUBIC or
+  // cv::INTER_LINEAR for zooming
+  ImagePipeline& Resize(cv::Size size, int interpolation = cv::INTER_AREA);
+  ImagePipeline& Scale(double factor, int interpolation = cv::INTER_LINEAR);
+  ImagePipeline& Crop(cv::Rect rect);
+  // Top left part of the image, sizes are fractions of the image size
+  ImagePipeline& CropFraction(double width, double height);
+  ImagePipeline& Translate(double dx, double dy);
+  // Rotation around the image center, angle in degrees
+  ImagePipeline& Rotate(double angle, double scale = 1);
+  ImagePipeline& Pad(int top,
+                     int bottom,
+                     int left,
+                     int right,
+                     cv::Scalar value,
+                     int border = cv::BORDER_CONSTANT | cv::BORDER_ISOLATED);
+  ImagePipeline& CvtColor(int code);
+  ImagePipeline& Add(Op op);
+
+  // The result refers to one of the scratch images of the calling thread, it
+  // is valid until the next call on this thread
+  const cv::Mat& Apply(const cv::Mat& img) const;
+
+  // Decodes the files, applies the operations, converts results to float
+  // multiplied by scale and writes them channels first to the packed tensor
+  // file. Images are processed in parallel by batches, so memory use does
+  // not depend on the number of files.
+  PipelineStats Run(const std::vector<std::string>& file_names,
+                    const std::string& output_file_name,
+                    const TensorShape& shape,
+                    double scale = 1. / 255,
+                    size_t batch_size = 256) const;
+
+ private:
+  std::vector<Op> ops_;
+};
+
+// Compressed file bytes are read into a reused buffer, cv::imread allocates
+// one for every file. The given image is released before decoding, so it is
+// empty if the file can not be read or decoded and false is returned.
+bool DecodeImage(const std::string& file_name, cv::Mat& img);
+
+// Regular files of the directory sorted by name
+std::vector<std::string> ListImageFiles(const std::string& dir_name);
+
+#endif  // IMAGE_PIPELINE_H
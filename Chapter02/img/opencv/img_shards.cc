@@ -0,0 +1,222 @@
+#include "../common/channels.h"
+#include "../common/image_shard.h"
+#include "image_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <experimental/filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+// Converts an image directory to training shards. Images of every
+// subdirectory are labeled with its index in name order and the names are
+// written to "<prefix>.classes", images in the directory itself are labeled
+// -1. With a positive size images are stored as decoded RGB uint8 tensors of
+// 3 x size x size, with size 0 file bytes are stored as they are. With --idx
+// MNIST images and labels IDX files are converted to 1 x rows x cols uint8
+// tensors labeled with the digits.
+
+struct LabeledFile {
+  std::string name;
+  int64_t label{-1};
+};
+
+std::vector<LabeledFile> ListDataset(const std::string& dir_name,
+                                     const std::string& classes_file_name) {
+  std::vector<LabeledFile> files;
+  for (auto& name : ListImageFiles(dir_name))
+    files.push_back({name, -1});
+  std::vector<std::string> classes;
+  for (auto& entry : fs::directory_iterator(dir_name)) {
+    if (fs::is_directory(entry.status()))
+      classes.push_back(entry.path().string());
+  }
+  std::sort(classes.begin(), classes.end());
+  std::ofstream classes_file(classes_file_name);
+  for (size_t label = 0; label < classes.size(); ++label) {
+    for (auto& name : ListImageFiles(classes[label]))
+      files.push_back({name, static_cast<int64_t>(label)});
+    classes_file << fs::path(classes[label]).filename().string() << "\n";
+  }
+  return files;
+}
+
+// Images are decoded and resized in parallel by batches, records are added
+// in the file order
+size_t WriteTensors(const std::vector<LabeledFile>& files,
+                    int size,
+                    img::ImageShardWriter& writer) {
+  ImagePipeline pipeline;
+  pipeline.Resize({size, size}, cv::INTER_AREA).CvtColor(cv::COLOR_BGR2RGB);
+  const size_t record_size = 3 * static_cast<size_t>(size) * size;
+  const size_t batch_size = 256;
+  std::vector<uint8_t> batch(batch_size * record_size);
+  std::vector<char> done(batch_size);
+  size_t failed = 0;
+  for (size_t first = 0; first < files.size(); first += batch_size) {
+    const auto count = std::min(batch_size, files.size() - first);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < count; ++i) {
+      thread_local cv::Mat decoded;
+      done[i] = false;
+      try {
+        if (DecodeImage(files[first + i].name, decoded)) {
+          const auto& rgb = pipeline.Apply(decoded);
+          img::HwcToChw(rgb.ptr<uint8_t>(), rgb.step,
+                        static_cast<size_t>(rgb.rows),
+                        static_cast<size_t>(rgb.cols),
+                        batch.data() + i * record_size);
+          done[i] = true;
+        }
+      } catch (const std::exception&) {
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      if (done[i]) {
+        writer.Add(batch.data() + i * record_size, record_size,
+                   files[first + i].label);
+      } else {
+        ++failed;
+      }
+    }
+  }
+  return failed;
+}
+
+struct IdxFile {
+  std::ifstream stream;
+  std::vector<uint32_t> dims;
+};
+
+// IDX file of unsigned bytes: the magic 0x0000080N for N dimensions, N
+// big-endian 32-bit sizes and the data
+IdxFile OpenIdx(const std::string& file_name, uint8_t dims_num) {
+  IdxFile file;
+  file.stream.open(file_name, std::ios::binary);
+  uint8_t bytes[4] = {};
+  if (!file.stream.read(reinterpret_cast<char*>(bytes), sizeof(bytes)) ||
+      bytes[0] != 0 || bytes[1] != 0 || bytes[2] != 0x08 ||
+      bytes[3] != dims_num)
+    throw std::runtime_error("Not an IDX file of bytes " + file_name);
+  for (uint8_t d = 0; d < dims_num; ++d) {
+    if (!file.stream.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+      throw std::runtime_error("Truncated IDX header " + file_name);
+    file.dims.push_back(uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 |
+                        uint32_t(bytes[2]) << 8 | uint32_t(bytes[3]));
+  }
+  return file;
+}
+
+// Records are copied as they are, IDX images already are uint8 tensors
+std::unique_ptr<img::ImageShardWriter> WriteIdx(
+    const std::string& images_file_name,
+    const std::string& labels_file_name,
+    const std::string& prefix) {
+  auto images = OpenIdx(images_file_name, 3);
+  auto labels = OpenIdx(labels_file_name, 1);
+  if (images.dims[0] != labels.dims[0])
+    throw std::runtime_error("Different numbers of images and labels in " +
+                             images_file_name + " and " + labels_file_name);
+  img::ShardInfo info{img::RecordType::Uint8, 1, images.dims[1],
+                      images.dims[2]};
+  auto writer = std::make_unique<img::ImageShardWriter>(prefix, info);
+  std::vector<char> record(info.RecordSize());
+  for (uint32_t i = 0; i < images.dims[0]; ++i) {
+    char label = 0;
+    if (!images.stream.read(record.data(),
+                            static_cast<std::streamsize>(record.size())) ||
+        !labels.stream.get(label))
+      throw std::runtime_error("Truncated IDX data in " + images_file_name +
+                               " or " + labels_file_name);
+    writer->Add(record.data(), record.size(), static_cast<uint8_t>(label));
+  }
+  return writer;
+}
+
+size_t WriteEncoded(const std::vector<LabeledFile>& files,
+                    img::ImageShardWriter& writer) {
+  std::vector<char> bytes;
+  size_t failed = 0;
+  for (auto& file : files) {
+    std::ifstream in(file.name, std::ios::binary | std::ios::ate);
+    auto size = in ? static_cast<std::streamsize>(in.tellg()) : 0;
+    bytes.resize(static_cast<size_t>(std::max<std::streamsize>(size, 0)));
+    if (size > 0 && in.seekg(0) && in.read(bytes.data(), size)) {
+      writer.Add(bytes.data(), bytes.size(), file.label);
+    } else {
+      ++failed;
+    }
+  }
+  return failed;
+}
+
+int main(int argc, char** argv) {
+  const bool idx = argc > 1 && std::string(argv[1]) == "--idx";
+  if ((idx && argc < 5) || (!idx && (argc < 3 || !fs::is_directory(argv[1])))) {
+    std::cerr << "Usage: img_shards <images dir> <output prefix> [size]\n"
+              << "       img_shards --idx <images file> <labels file> "
+                 "<output prefix>\n";
+    return 1;
+  }
+  try {
+    const std::string prefix = idx ? argv[4] : argv[2];
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<img::ImageShardWriter> writer;
+    size_t failed = 0;
+    if (idx) {
+      writer = WriteIdx(argv[2], argv[3], prefix);
+    } else {
+      const int size = argc > 3 ? std::stoi(argv[3]) : 0;
+      auto files = ListDataset(argv[1], prefix + ".classes");
+      img::ShardInfo info;
+      if (size > 0) {
+        info = {img::RecordType::Uint8, 3, static_cast<uint32_t>(size),
+                static_cast<uint32_t>(size)};
+      } else {
+        info.type = img::RecordType::Encoded;
+      }
+      writer = std::make_unique<img::ImageShardWriter>(prefix, info);
+      failed = size > 0 ? WriteTensors(files, size, *writer)
+                        : WriteEncoded(files, *writer);
+    }
+    writer->Close();
+    std::chrono::duration<double> write_time =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "Converted " << writer->Count() << " images (" << failed
+              << " failed) to " << writer->Shards() << " shards in "
+              << write_time.count() << "s, "
+              << writer->Count() / write_time.count() << " images/s"
+              << std::endl;
+
+    // random access in the training order touches only mapped memory
+    img::ImageShards shards(prefix);
+    std::vector<size_t> order(shards.Size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(0));
+    start = std::chrono::steady_clock::now();
+    size_t checksum = 0;
+    for (auto index : order) {
+      const auto& sample = shards.Get(index);
+      checksum += std::accumulate(sample.data, sample.data + sample.size,
+                                  size_t(0));
+    }
+    std::chrono::duration<double> read_time =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "Read " << shards.Size() << " samples in random order in "
+              << read_time.count() << "s, "
+              << shards.Size() / read_time.count()
+              << " samples/s, checksum " << checksum << std::endl;
+  } catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
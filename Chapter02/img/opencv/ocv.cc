@@ -1,13 +1,52 @@
+#include "../common/channels.h"
+#include "image_pipeline.h"
+
 #include <opencv2/highgui.hpp>
 #include <opencv2/opencv.hpp>
 
+#include <chrono>
 #include <experimental/filesystem>
 #include <iostream>
 #include <string>
 
 namespace fs = std::experimental::filesystem;
 
+// Same transformations as the interactive part below, applied without GUI to
+// all images of the directory. The first resize makes all results the same
+// size, so they are packed to one tensor file.
+int ProcessDirectory(const std::string& dir_name,
+                     const std::string& output_file_name) {
+  ImagePipeline pipeline;
+  pipeline.Resize({256, 256}, cv::INTER_AREA)
+      .Scale(1.5, cv::INTER_CUBIC)
+      .CropFraction(0.5, 0.5)
+      .Translate(-50, -50)
+      .Rotate(45)
+      .Pad(50, 20, 150, 5, cv::Scalar(255, 0, 0))
+      .CvtColor(cv::COLOR_BGR2RGB);
+  const auto& sample = pipeline.Apply(cv::Mat(256, 256, CV_8UC3));
+  TensorShape shape{sample.channels(), sample.rows, sample.cols};
+
+  auto file_names = ListImageFiles(dir_name);
+  auto stats = pipeline.Run(file_names, output_file_name, shape);
+  std::cout << "Processed " << stats.images << " images ("
+            << stats.failed << " failed) to " << shape.channels << "x"
+            << shape.rows << "x" << shape.cols << " tensors in "
+            << stats.seconds << "s, " << stats.ImagesPerSecond()
+            << " images/s" << std::endl;
+  return 0;
+}
+
 int main(int argc, char** argv) {
+  if (argc > 1 && fs::is_directory(argv[1])) {
+    try {
+      return ProcessDirectory(argv[1], argc > 2 ? argv[2] : "images.tensor");
+    } catch (const std::exception& err) {
+      std::cerr << err.what() << std::endl;
+      return 1;
+    }
+  }
+
   cv::Mat img;
   if (argc > 1) {
     auto file_path = fs::path(argv[1]);
@@ -100,16 +139,36 @@ int main(int argc, char** argv) {
   // layout of channels i in memory n OpenCV can be non continuous and
   // interleaved, so usually before passing OpenCV image to another library we
   // mix to restructure them
-  img = cv::Mat(512, 512, CV_32FC3);
-  img = cv::Scalar(255, 255, 255);
+  img = cv::Mat(1080, 1920, CV_8UC3);
+  cv::randu(img, 0, 256);
+  auto start = std::chrono::steady_clock::now();
+  cv::Mat float_img;
+  img.convertTo(float_img, CV_32FC3, 1. / 255);
   cv::Mat bgr[3];
-  cv::split(img, bgr);
+  cv::split(float_img, bgr);
   cv::Mat ordered_channels;
   cv::vconcat(bgr[2], bgr[1], ordered_channels);
   cv::vconcat(ordered_channels, bgr[0], ordered_channels);
+  std::chrono::duration<double, std::milli> split_time =
+      std::chrono::steady_clock::now() - start;
 
   std::cout << "Memory layout is continuous " << ordered_channels.isContinuous()
             << std::endl;
 
+  // Vectorized kernel does the same conversion, scaling and reordering in one
+  // pass and writes the planes to a preallocated buffer
+  cv::Mat tensor(3 * img.rows, img.cols, CV_32FC1);
+  const float to_unit = 1.f / 255;
+  start = std::chrono::steady_clock::now();
+  img::HwcToChw(img.ptr<uint8_t>(), img.step, static_cast<size_t>(img.rows),
+                static_cast<size_t>(img.cols), tensor.ptr<float>(),
+                {{2, 1, 0}, {to_unit, to_unit, to_unit}, {}});
+  std::chrono::duration<double, std::milli> kernel_time =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "Channels mix: split and vconcat " << split_time.count()
+            << " ms, " << img::ChannelKernelsIsa() << " kernel "
+            << kernel_time.count() << " ms, max difference "
+            << cv::norm(tensor, ordered_channels, cv::NORM_INF) << std::endl;
+
   return 0;
 }
@@ -2,9 +2,12 @@
 
 #include <Eigen/Dense>
 
+#include <algorithm>
+#include <chrono>
 #include <experimental/filesystem>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace fs = std::experimental::filesystem;
 
@@ -12,7 +15,36 @@ int main(int argc, char** argv) {
   if (argc > 1) {
     auto file_path = fs::path(argv[1]);
     if (fs::exists(file_path)) {
-      auto papers = ReadPapersReviews(file_path);
+      auto start = std::chrono::steady_clock::now();
+      PapersReviews papers_reviews;
+      uintmax_t input_size = 0;
+      if (fs::is_directory(file_path)) {
+        // every json file of the directory, parsed in parallel
+        std::vector<std::string> file_names;
+        for (const auto& entry : fs::directory_iterator(file_path)) {
+          if (fs::is_regular_file(entry.path()) &&
+              entry.path().extension() == ".json") {
+            file_names.push_back(entry.path().string());
+            input_size += fs::file_size(entry.path());
+          }
+        }
+        std::sort(file_names.begin(), file_names.end());
+        papers_reviews = ReadPapersReviews(file_names);
+      } else if (file_path.extension() == ".ndjson" ||
+                 file_path.extension() == ".jsonl") {
+        input_size = fs::file_size(file_path);
+        papers_reviews = ReadPapersReviewsNdjson(file_path.string());
+      } else {
+        input_size = fs::file_size(file_path);
+        papers_reviews = ReadPapersReviews(file_path.string());
+      }
+      const auto& papers = papers_reviews.papers;
+      std::chrono::duration<double> parse_time =
+          std::chrono::steady_clock::now() - start;
+      auto file_mb = static_cast<double>(input_size) / 1e6;
+      std::cerr << "Parsed " << papers.size() << " papers in "
+                << parse_time.count() << "s, "
+                << file_mb / parse_time.count() << " MB/s" << std::endl;
       // create matrices
       Eigen::MatrixXi x_data(papers.size(), 3);
       Eigen::MatrixXi y_data(papers.size(), 1);
@@ -28,9 +60,9 @@ int main(int argc, char** argv) {
           int64_t evaluation_avg = 0;
           int64_t orientation_avg = 0;
           for (const auto& r : p.reviews) {
-            confidence_avg += std::stoi(r.confidence);
-            evaluation_avg += std::stoi(r.evaluation);
-            orientation_avg += std::stoi(r.orientation);
+            confidence_avg += ReviewScore(r.confidence);
+            evaluation_avg += ReviewScore(r.evaluation);
+            orientation_avg += ReviewScore(r.orientation);
           }
           int64_t reviews_num = static_cast<int64_t>(p.reviews.size());
           x_data(i, 0) = static_cast<int>(confidence_avg / reviews_num);
@@ -7,10 +7,16 @@
 
 struct Paper {
   uint32_t id{0};
-  std::string preliminary_decision;
+  std::string_view preliminary_decision;
   std::vector<Review> reviews;
 };
 
 using Papers = std::vector<Paper>;
 
+// Papers together with the text buffers their string fields point into
+struct PapersReviews {
+  std::vector<std::vector<char>> buffers;
+  Papers papers;
+};
+
 #endif  // PAPER_H
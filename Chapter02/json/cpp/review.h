@@ -1,17 +1,27 @@
 #ifndef REVIEW_H
 #define REVIEW_H
 
-#include <string>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
 
+// String fields point into the buffer the review was parsed from
 struct Review {
-  std::string confidence;
-  std::string evaluation;
+  std::string_view confidence;
+  std::string_view evaluation;
   uint32_t id{0};
-  std::string language;
-  std::string orientation;
-  std::string remarks;
-  std::string text;
-  std::string timespan;
+  std::string_view language;
+  std::string_view orientation;
+  std::string_view remarks;
+  std::string_view text;
+  std::string_view timespan;
 };
 
+// Integer value of a numeric review field, 0 if it is not a number
+inline int32_t ReviewScore(std::string_view field) {
+  int32_t value{0};
+  std::from_chars(field.data(), field.data() + field.size(), value);
+  return value;
+}
+
 #endif  // REVIEW_H
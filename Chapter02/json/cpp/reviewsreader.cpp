@@ -1,10 +1,20 @@
 #include "reviewsreader.h"
+#include "string_arena.h"
 
 #include <rapidjson/error/en.h>
 #include <rapidjson/filereadstream.h>
 #include <rapidjson/reader.h>
 
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
 
 enum class HandlerState {
   None,
@@ -15,68 +25,175 @@ enum class HandlerState {
   Review
 };
 
+// Known object keys, None means that no key is pending
+enum class Field : uint8_t {
+  None,
+  Unknown,
+  Paper,
+  Id,
+  PreliminaryDecision,
+  Review,
+  Confidence,
+  Evaluation,
+  Language,
+  Orientation,
+  Remarks,
+  Text,
+  Timespan
+};
+
+struct FieldName {
+  std::string_view name;
+  Field field{Field::Unknown};
+};
+
+constexpr FieldName kFieldNames[] = {{"paper", Field::Paper},
+                                     {"id", Field::Id},
+                                     {"preliminary_decision",
+                                      Field::PreliminaryDecision},
+                                     {"review", Field::Review},
+                                     {"confidence", Field::Confidence},
+                                     {"evaluation", Field::Evaluation},
+                                     {"lan", Field::Language},
+                                     {"orientation", Field::Orientation},
+                                     {"remarks", Field::Remarks},
+                                     {"text", Field::Text},
+                                     {"timespan", Field::Timespan}};
+
+constexpr uint32_t kFieldTableBits = 5;
+constexpr size_t kFieldTableSize = size_t(1) << kFieldTableBits;
+
+// Multiplicative hash of the name length and its first and last characters,
+// which are enough to tell the known names apart. Names must not be empty.
+constexpr uint32_t FieldHash(std::string_view name, uint32_t seed) {
+  uint32_t key = static_cast<uint32_t>(name.size()) |
+                 uint32_t(static_cast<unsigned char>(name.front())) << 8 |
+                 uint32_t(static_cast<unsigned char>(name.back())) << 16;
+  return (key * seed) >> (32 - kFieldTableBits);
+}
+
+constexpr bool IsPerfectSeed(uint32_t seed) {
+  bool used[kFieldTableSize]{};
+  for (const auto& field_name : kFieldNames) {
+    auto slot = FieldHash(field_name.name, seed);
+    if (used[slot])
+      return false;
+    used[slot] = true;
+  }
+  return true;
+}
+
+// The first odd seed without collisions is searched at compile time
+constexpr uint32_t FindFieldSeed() {
+  uint32_t seed = 0x9e3779b1;
+  while (!IsPerfectSeed(seed))
+    seed += 2;
+  return seed;
+}
+
+constexpr uint32_t kFieldSeed = FindFieldSeed();
+
+constexpr std::array<FieldName, kFieldTableSize> MakeFieldTable() {
+  std::array<FieldName, kFieldTableSize> table{};
+  for (const auto& field_name : kFieldNames)
+    table[FieldHash(field_name.name, kFieldSeed)] = field_name;
+  return table;
+}
+
+constexpr auto kFieldTable = MakeFieldTable();
+
+// One hash and one comparison, no allocations
+constexpr Field FindField(std::string_view name) {
+  if (name.empty())
+    return Field::Unknown;
+  const auto& slot = kFieldTable[FieldHash(name, kFieldSeed)];
+  return slot.name == name ? slot.field : Field::Unknown;
+}
+
+static_assert(FindField("timespan") == Field::Timespan);
+static_assert(FindField("lan") == Field::Language);
+static_assert(FindField("language") == Field::Unknown);
+
+// Receives every parsed paper, the paper can be moved from
+using PaperSink = std::function<void(Paper&)>;
+
+// Strings passed without the copy flag (in situ parsing) are referenced
+// directly, others are valid only during the event call and are copied to
+// the arena, which is cleared after every paper.
 struct ReviewsHandler
     : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ReviewsHandler> {
-  ReviewsHandler(Papers* papers) : papers_(papers) {}
+  // Newline delimited files start inside the papers array
+  ReviewsHandler(PaperSink sink,
+                 StringArena* arena,
+                 HandlerState state = HandlerState::None)
+      : sink_(std::move(sink)), arena_(arena), state_(state) {}
 
   bool Uint(unsigned u) {
-    bool res{true};
-    try {
-      if (state_ == HandlerState::Paper && key_ == "id") {
-        paper_.id = u;
-      } else if (state_ == HandlerState::Review && key_ == "id") {
-        review_.id = u;
-      } else {
-        res = false;
-      }
-    } catch (...) {
-      res = false;
+    auto key = std::exchange(key_, Field::None);
+    if (key != Field::Id)
+      return false;
+    if (state_ == HandlerState::Paper) {
+      paper_.id = u;
+    } else if (state_ == HandlerState::Review) {
+      review_.id = u;
+    } else {
+      return false;
     }
-    key_.clear();
-    return res;
+    return true;
   }
 
-  bool String(const char* str, rapidjson::SizeType length, bool /*copy*/) {
-    bool res{true};
-    try {
-      if (state_ == HandlerState::Paper && key_ == "preliminary_decision") {
-        paper_.preliminary_decision = std::string(str, length);
-      } else if (state_ == HandlerState::Review && key_ == "confidence") {
-        review_.confidence = std::string(str, length);
-      } else if (state_ == HandlerState::Review && key_ == "evaluation") {
-        review_.evaluation = std::string(str, length);
-      } else if (state_ == HandlerState::Review && key_ == "lan") {
-        review_.language = std::string(str, length);
-      } else if (state_ == HandlerState::Review && key_ == "orientation") {
-        review_.orientation = std::string(str, length);
-      } else if (state_ == HandlerState::Review && key_ == "remarks") {
-        review_.remarks = std::string(str, length);
-      } else if (state_ == HandlerState::Review && key_ == "text") {
-        review_.text = std::string(str, length);
-      } else if (state_ == HandlerState::Review && key_ == "timespan") {
-        review_.timespan = std::string(str, length);
-      } else {
-        res = false;
+  bool String(const char* str, rapidjson::SizeType length, bool copy) {
+    auto key = std::exchange(key_, Field::None);
+    std::string_view* value{nullptr};
+    if (state_ == HandlerState::Paper) {
+      if (key == Field::PreliminaryDecision)
+        value = &paper_.preliminary_decision;
+    } else if (state_ == HandlerState::Review) {
+      switch (key) {
+        case Field::Confidence:
+          value = &review_.confidence;
+          break;
+        case Field::Evaluation:
+          value = &review_.evaluation;
+          break;
+        case Field::Language:
+          value = &review_.language;
+          break;
+        case Field::Orientation:
+          value = &review_.orientation;
+          break;
+        case Field::Remarks:
+          value = &review_.remarks;
+          break;
+        case Field::Text:
+          value = &review_.text;
+          break;
+        case Field::Timespan:
+          value = &review_.timespan;
+          break;
+        default:
+          break;
       }
-    } catch (...) {
-      res = false;
     }
-    key_.clear();
-    return res;
+    if (value == nullptr)
+      return false;
+    *value = copy ? arena_->Store(str, length) : std::string_view(str, length);
+    return true;
   }
 
   bool Key(const char* str, rapidjson::SizeType length, bool /*copy*/) {
-    key_ = std::string(str, length);
+    key_ = FindField(std::string_view(str, length));
     return true;
   }
 
   bool StartObject() {
-    if (state_ == HandlerState::None && key_.empty()) {
+    if (state_ == HandlerState::None && key_ == Field::None) {
       state_ = HandlerState::Global;
-    } else if (state_ == HandlerState::PapersArray && key_.empty()) {
+    } else if (state_ == HandlerState::PapersArray && key_ == Field::None) {
       state_ = HandlerState::Paper;
-    } else if (state_ == HandlerState::ReviewArray && key_.empty()) {
+    } else if (state_ == HandlerState::ReviewArray && key_ == Field::None) {
       state_ = HandlerState::Review;
+      review_ = Review();
     } else {
       return false;
     }
@@ -88,8 +205,12 @@ struct ReviewsHandler
       state_ = HandlerState::None;
     } else if (state_ == HandlerState::Paper) {
       state_ = HandlerState::PapersArray;
-      papers_->push_back(paper_);
-      paper_ = Paper();
+      sink_(paper_);
+      // keep the reviews capacity for the next paper
+      paper_.id = 0;
+      paper_.preliminary_decision = {};
+      paper_.reviews.clear();
+      arena_->Clear();
     } else if (state_ == HandlerState::Review) {
       state_ = HandlerState::ReviewArray;
       paper_.reviews.push_back(review_);
@@ -100,12 +221,11 @@ struct ReviewsHandler
   }
 
   bool StartArray() {
-    if (state_ == HandlerState::Global && key_ == "paper") {
+    auto key = std::exchange(key_, Field::None);
+    if (state_ == HandlerState::Global && key == Field::Paper) {
       state_ = HandlerState::PapersArray;
-      key_.clear();
-    } else if (state_ == HandlerState::Paper && key_ == "review") {
+    } else if (state_ == HandlerState::Paper && key == Field::Review) {
       state_ = HandlerState::ReviewArray;
-      key_.clear();
     } else {
       return false;
     }
@@ -125,12 +245,161 @@ struct ReviewsHandler
 
   Paper paper_;
   Review review_;
-  std::string key_;
-  Papers* papers_{nullptr};
+  Field key_{Field::None};
+  PaperSink sink_;
+  StringArena* arena_{nullptr};
   HandlerState state_{HandlerState::None};
 };
 
-Papers ReadPapersReviews(const std::string& filename) {
+namespace {
+// Whole file with a terminating zero required by the in situ stream
+std::vector<char> LoadFile(const std::string& filename) {
+  auto file = std::unique_ptr<FILE, void (*)(FILE*)>(
+      fopen(filename.c_str(), "rb"), [](FILE* f) {
+        if (f)
+          ::fclose(f);
+      });
+  if (!file) {
+    throw std::invalid_argument("File can't be opened " + filename);
+  }
+  ::fseek(file.get(), 0, SEEK_END);
+  auto size = ::ftell(file.get());
+  ::fseek(file.get(), 0, SEEK_SET);
+  if (size < 0) {
+    throw std::runtime_error("Failed to get the size of " + filename);
+  }
+  std::vector<char> buffer(static_cast<size_t>(size) + 1);
+  if (::fread(buffer.data(), 1, static_cast<size_t>(size), file.get()) !=
+      static_cast<size_t>(size)) {
+    throw std::runtime_error("Failed to read " + filename);
+  }
+  buffer.back() = '\0';
+  return buffer;
+}
+
+// Parses the zero terminated text in place and appends its papers, returns
+// an error message or an empty string
+std::string ParseInsitu(char* text, bool ndjson, Papers& papers) {
+  rapidjson::InsituStringStream is(text);
+  rapidjson::Reader reader;
+  StringArena arena;
+  ReviewsHandler handler(
+      [&papers](Paper& paper) { papers.push_back(std::move(paper)); }, &arena,
+      ndjson ? HandlerState::PapersArray : HandlerState::None);
+  if (!ndjson) {
+    auto res = reader.Parse<rapidjson::kParseInsituFlag>(is, handler);
+    return res ? std::string() : rapidjson::GetParseError_En(res.Code());
+  }
+  // one paper object per line, parsed one after another
+  for (;;) {
+    while (is.Peek() == ' ' || is.Peek() == '\n' || is.Peek() == '\r' ||
+           is.Peek() == '\t')
+      is.Take();
+    if (is.Peek() == '\0')
+      return {};
+    auto res = reader.Parse<rapidjson::kParseInsituFlag |
+                            rapidjson::kParseStopWhenDoneFlag>(is, handler);
+    if (!res)
+      return rapidjson::GetParseError_En(res.Code());
+  }
+}
+
+// Moves the papers of all parts into one vector keeping the parts order
+Papers MergePapers(std::vector<Papers>& parts) {
+  size_t total = 0;
+  for (const auto& part : parts)
+    total += part.size();
+  Papers papers;
+  papers.reserve(total);
+  for (auto& part : parts)
+    std::move(part.begin(), part.end(), std::back_inserter(papers));
+  return papers;
+}
+
+// Throws the error of the first failed part, so the reported error does not
+// depend on the threads scheduling
+void CheckErrors(const std::vector<std::string>& errors) {
+  for (const auto& error : errors) {
+    if (!error.empty())
+      throw std::runtime_error(error);
+  }
+}
+}  // namespace
+
+PapersReviews ReadPapersReviews(const std::string& filename) {
+  PapersReviews result;
+  result.buffers.push_back(LoadFile(filename));
+  auto error = ParseInsitu(result.buffers[0].data(), false, result.papers);
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+  return result;
+}
+
+PapersReviews ReadPapersReviews(const std::vector<std::string>& filenames) {
+  const auto files_num = filenames.size();
+  PapersReviews result;
+  result.buffers.resize(files_num);
+  std::vector<Papers> parts(files_num);
+  std::vector<std::string> errors(files_num);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < files_num; ++i) {
+    try {
+      result.buffers[i] = LoadFile(filenames[i]);
+      errors[i] = ParseInsitu(result.buffers[i].data(), false, parts[i]);
+      if (!errors[i].empty())
+        errors[i] = filenames[i] + ": " + errors[i];
+    } catch (const std::exception& err) {
+      errors[i] = err.what();
+    }
+  }
+  CheckErrors(errors);
+  result.papers = MergePapers(parts);
+  return result;
+}
+
+PapersReviews ReadPapersReviewsNdjson(const std::string& filename,
+                                      size_t chunks_num) {
+  PapersReviews result;
+  result.buffers.push_back(LoadFile(filename));
+  auto& buffer = result.buffers[0];
+  auto* text = buffer.data();
+  const auto size = buffer.size() - 1;
+  if (chunks_num == 0)
+    chunks_num = static_cast<size_t>(omp_get_max_threads()) * 4;
+
+  // chunk borders are moved to the following newlines, which are replaced
+  // with zeros to terminate the chunks for the in situ streams
+  std::vector<size_t> borders{0};
+  for (size_t i = 1; i < chunks_num; ++i) {
+    auto border = std::max(borders.back(), size * i / chunks_num);
+    while (border < size && text[border] != '\n')
+      ++border;
+    if (border >= size)
+      break;
+    text[border] = '\0';
+    borders.push_back(border + 1);
+  }
+  borders.push_back(size + 1);
+
+  const auto parts_num = borders.size() - 1;
+  std::vector<Papers> parts(parts_num);
+  std::vector<std::string> errors(parts_num);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < parts_num; ++i) {
+    try {
+      errors[i] = ParseInsitu(text + borders[i], true, parts[i]);
+    } catch (const std::exception& err) {
+      errors[i] = err.what();
+    }
+  }
+  CheckErrors(errors);
+  result.papers = MergePapers(parts);
+  return result;
+}
+
+void VisitPapersReviews(const std::string& filename,
+                        const PaperVisitor& visitor) {
   auto file = std::unique_ptr<FILE, void (*)(FILE*)>(
       fopen(filename.c_str(), "r"), [](FILE* f) {
         if (f)
@@ -140,13 +409,13 @@ Papers ReadPapersReviews(const std::string& filename) {
     char readBuffer[65536];
     rapidjson::FileReadStream is(file.get(), readBuffer, sizeof(readBuffer));
     rapidjson::Reader reader;
-    Papers papers;
-    ReviewsHandler handler(&papers);
+    StringArena arena;
+    ReviewsHandler handler([&visitor](Paper& paper) { visitor(paper); },
+                           &arena);
     auto res = reader.Parse(is, handler);
     if (!res) {
       throw std::runtime_error(rapidjson::GetParseError_En(res.Code()));
     }
-    return papers;
   } else {
     throw std::invalid_argument("File can't be opened " + filename);
   }
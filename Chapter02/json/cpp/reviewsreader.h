@@ -3,6 +3,33 @@
 
 #include "paper.h"
 
-Papers ReadPapersReviews(const std::string& filename);
+#include <functional>
+#include <string>
+#include <vector>
+
+// The whole file is loaded into one buffer and parsed in place: strings are
+// unescaped inside the buffer and the papers fields are views into it, so
+// parsing does not allocate per string or per review.
+PapersReviews ReadPapersReviews(const std::string& filename);
+
+// Files are loaded and parsed in parallel, one file per task; papers are
+// merged in the files order, so the result does not depend on the threads
+// number.
+PapersReviews ReadPapersReviews(const std::vector<std::string>& filenames);
+
+// Newline delimited json with one paper object per line. The file is split
+// into chunks at line boundaries which are parsed in place in parallel,
+// papers keep the file order. 0 chunks means 4 per thread.
+PapersReviews ReadPapersReviewsNdjson(const std::string& filename,
+                                      size_t chunks_num = 0);
+
+using PaperVisitor = std::function<void(const Paper&)>;
+
+// Streaming reader: the file is parsed through a 64 KB read buffer and every
+// paper is passed to the visitor as soon as its object ends. Paper strings
+// are valid only during the visitor call, they are kept in an arena which is
+// reused for the next paper, so memory use does not depend on the file size.
+void VisitPapersReviews(const std::string& filename,
+                        const PaperVisitor& visitor);
 
 #endif  // REVIEWSREADER_H
@@ -0,0 +1,55 @@
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Bump allocator for strings which live until the next Clear call. Blocks
+// are kept between clears, so a cleared arena is reused without allocations
+// once it has grown to the size of the largest batch of strings.
+class StringArena {
+ public:
+  explicit StringArena(size_t block_size = 64 * 1024)
+      : block_size_(block_size) {}
+
+  std::string_view Store(const char* str, size_t length) {
+    if (length == 0)
+      return {};
+    if (current_ == blocks_.size() ||
+        blocks_[current_].size - offset_ < length) {
+      if (current_ < blocks_.size())
+        ++current_;
+      offset_ = 0;
+      if (current_ == blocks_.size() || blocks_[current_].size < length) {
+        auto size = std::max(block_size_, length);
+        blocks_.insert(blocks_.begin() + static_cast<ptrdiff_t>(current_),
+                       Block{std::make_unique<char[]>(size), size});
+      }
+    }
+    auto* dst = blocks_[current_].data.get() + offset_;
+    std::memcpy(dst, str, length);
+    offset_ += length;
+    return std::string_view(dst, length);
+  }
+
+  void Clear() {
+    current_ = 0;
+    offset_ = 0;
+  }
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size{0};
+  };
+
+  size_t block_size_;
+  std::vector<Block> blocks_;
+  size_t current_{0};
+  size_t offset_{0};
+};
+
+#endif  // STRING_ARENA_H
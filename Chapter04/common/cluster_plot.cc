@@ -0,0 +1,150 @@
+#include "cluster_plot.h"
+
+#include <plot.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+namespace clustering {
+
+namespace {
+struct Grid {
+  DataType min_x{std::numeric_limits<DataType>::max()};
+  DataType min_y{std::numeric_limits<DataType>::max()};
+  DataType scale_x{0};
+  DataType scale_y{0};
+  size_t width{1};
+  size_t height{1};
+
+  size_t Cell(DataType x, DataType y) const {
+    auto cx = static_cast<size_t>((x - min_x) * scale_x);
+    auto cy = static_cast<size_t>((y - min_y) * scale_y);
+    return cy * width + cx;
+  }
+};
+
+Grid MakeGrid(DataType min_x,
+              DataType max_x,
+              DataType min_y,
+              DataType max_y,
+              const ClusterPlotOptions& options) {
+  Grid grid;
+  grid.width = std::max<size_t>(options.width, 1);
+  grid.height = std::max<size_t>(options.height, 1);
+  grid.min_x = min_x;
+  grid.min_y = min_y;
+  grid.scale_x =
+      max_x > min_x ? (grid.width - 1) / (max_x - min_x) : DataType(0);
+  grid.scale_y =
+      max_y > min_y ? (grid.height - 1) / (max_y - min_y) : DataType(0);
+  return grid;
+}
+
+// Writes the binned points of the clusters to a binary float file, gnuplot
+// draws them from it and the file is removed when gnuplot exits
+size_t Plot(const std::vector<std::vector<float>>& reduced,
+            const std::vector<size_t>& ids,
+            const std::vector<std::string>& colors,
+            const std::string& title,
+            const std::string& file_name,
+            const Grid& grid) {
+  const auto data_file_name = file_name + ".bin";
+  auto data_file = std::fopen(data_file_name.c_str(), "wb");
+  if (!data_file)
+    return 0;
+  std::stringstream plot_cmd;
+  plot_cmd << "plot ";
+  size_t total = 0;
+  for (size_t c = 0; c < reduced.size(); ++c) {
+    auto& points = reduced[c];
+    if (points.empty())
+      continue;
+    std::fwrite(points.data(), sizeof(float), points.size(), data_file);
+    if (total > 0)
+      plot_cmd << ", ";
+    plot_cmd << "'" << data_file_name << "' binary skip="
+             << total * 2 * sizeof(float) << " record=" << points.size() / 2
+             << " format='%float%float' using 1:2 with points lc rgb '";
+    if (ids[c] == kNoiseLabel)
+      plot_cmd << "gray' pt 7 title 'noise'";
+    else
+      plot_cmd << colors[ids[c] % colors.size()] << "' pt 7 title '" << ids[c]
+               << " cls'";
+    total += points.size() / 2;
+  }
+  std::fclose(data_file);
+
+  {
+    // the destructor waits for gnuplot to finish reading the file
+    plotcpp::Plot plt;
+    std::stringstream terminal;
+    terminal << "png size " << grid.width << "," << grid.height;
+    plt.SetTerminal(terminal.str());
+    plt.SetOutput(file_name);
+    plt.SetTitle(title);
+    plt.SetXLabel("x");
+    plt.SetYLabel("y");
+    plt.SetAutoscale();
+    plt.GnuplotCommand("set grid");
+    plt.GnuplotCommand(plot_cmd.str());
+    plt.Flush();
+  }
+  std::remove(data_file_name.c_str());
+  return total;
+}
+}  // namespace
+
+size_t DrawClusters(PointsView points,
+                    const std::vector<size_t>& labels,
+                    const std::vector<std::string>& colors,
+                    const std::string& title,
+                    const std::string& file_name,
+                    const ClusterPlotOptions& options) {
+  const auto rows = std::min(points.rows, labels.size());
+  if (rows == 0 || points.cols < 2)
+    return 0;
+  auto min_x = std::numeric_limits<DataType>::max();
+  auto min_y = std::numeric_limits<DataType>::max();
+  auto max_x = std::numeric_limits<DataType>::lowest();
+  auto max_y = std::numeric_limits<DataType>::lowest();
+  size_t max_label = 0;
+#pragma omp parallel for reduction(min : min_x, min_y) \
+    reduction(max : max_x, max_y, max_label) schedule(static)
+  for (size_t i = 0; i < rows; ++i) {
+    min_x = std::min(min_x, points[i][0]);
+    max_x = std::max(max_x, points[i][0]);
+    min_y = std::min(min_y, points[i][1]);
+    max_y = std::max(max_y, points[i][1]);
+    if (labels[i] != kNoiseLabel)
+      max_label = std::max(max_label, labels[i]);
+  }
+  if (max_label >= rows)
+    return 0;  // not a cluster index
+  const auto grid = MakeGrid(min_x, max_x, min_y, max_y, options);
+
+  // one pass over the samples, every label has its own occupancy grid, noise
+  // samples go to the first one so clusters are drawn over them
+  std::vector<std::vector<float>> reduced(max_label + 2);
+  std::vector<std::vector<uint8_t>> occupied(max_label + 2);
+  for (size_t i = 0; i < rows; ++i) {
+    auto label = labels[i] == kNoiseLabel ? 0 : labels[i] + 1;
+    if (occupied[label].empty())
+      occupied[label].resize(grid.width * grid.height);
+    auto& cell = occupied[label][grid.Cell(points[i][0], points[i][1])];
+    if (!cell) {
+      cell = 1;
+      reduced[label].push_back(static_cast<float>(points[i][0]));
+      reduced[label].push_back(static_cast<float>(points[i][1]));
+    }
+  }
+  std::vector<size_t> ids(reduced.size());
+  ids[0] = kNoiseLabel;
+  for (size_t c = 1; c < reduced.size(); ++c)
+    ids[c] = c - 1;
+  return Plot(reduced, ids, colors, title, file_name, grid);
+}
+
+}  // namespace clustering
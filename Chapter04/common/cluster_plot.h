@@ -0,0 +1,39 @@
+#ifndef CLUSTER_PLOT_H
+#define CLUSTER_PLOT_H
+
+#include "points.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace clustering {
+
+// Label of samples which belong to no cluster, e.g. DBSCAN noise
+constexpr size_t kNoiseLabel = std::numeric_limits<size_t>::max();
+
+struct ClusterPlotOptions {
+  // PNG size, points are binned into a grid with one cell per pixel
+  size_t width{640};
+  size_t height{480};
+};
+
+// Draws samples to a PNG file with the colors of their cluster labels, the
+// first two columns are the coordinates. The samples are binned into a pixel
+// grid in one pass, only one point per occupied cell of every cluster is
+// kept, so the picture is the same while gnuplot gets at most
+// width * height points per cluster. The points are passed to gnuplot as a
+// binary float file instead of text, the file is removed after drawing.
+// Samples labeled kNoiseLabel are drawn in gray, any other label must be
+// less than the number of samples, otherwise nothing is drawn. Returns the
+// number of points drawn.
+size_t DrawClusters(PointsView points,
+                    const std::vector<size_t>& labels,
+                    const std::vector<std::string>& colors,
+                    const std::string& title,
+                    const std::string& file_name,
+                    const ClusterPlotOptions& options = {});
+
+}  // namespace clustering
+
+#endif  // CLUSTER_PLOT_H
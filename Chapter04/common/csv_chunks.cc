@@ -0,0 +1,53 @@
+#include "csv_chunks.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace clustering {
+
+CsvChunkReader::CsvChunkReader(const std::string& file_name,
+                               std::vector<size_t> columns)
+    : file_(file_name), columns_(std::move(columns)) {}
+
+bool CsvChunkReader::ReadChunk(Points& chunk, size_t max_rows) {
+  chunk.cols = columns_.size();
+  chunk.values.resize(max_rows * chunk.cols);
+  size_t rows = 0;
+  while (rows < max_rows && std::getline(file_, line_)) {
+    if (ParseLine(line_, chunk[rows]))
+      ++rows;
+  }
+  chunk.rows = rows;
+  chunk.values.resize(rows * chunk.cols);
+  return rows > 0;
+}
+
+void CsvChunkReader::Rewind() {
+  file_.clear();
+  file_.seekg(0);
+}
+
+bool CsvChunkReader::ParseLine(const std::string& line,
+                               DataType* values) const {
+  const char* pos = line.c_str();
+  size_t found = 0;
+  for (size_t column = 0; found < columns_.size(); ++column) {
+    auto it = std::find(columns_.begin(), columns_.end(), column);
+    if (it != columns_.end()) {
+      char* end = nullptr;
+      auto value = std::strtod(pos, &end);
+      if (end == pos)
+        return false;  // header or malformed row
+      values[std::distance(columns_.begin(), it)] = value;
+      ++found;
+    }
+    pos = std::strchr(pos, ',');
+    if (pos == nullptr)
+      break;
+    ++pos;
+  }
+  return found == columns_.size();
+}
+
+}  // namespace clustering
@@ -0,0 +1,37 @@
+#ifndef CSV_CHUNKS_H
+#define CSV_CHUNKS_H
+
+#include "points.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace clustering {
+
+// Reads selected numeric columns of a comma separated file in chunks of
+// rows, so datasets larger than memory can be processed in a streaming way
+class CsvChunkReader {
+ public:
+  CsvChunkReader(const std::string& file_name, std::vector<size_t> columns);
+
+  // Reads up to max_rows rows into chunk (resized to the read rows number),
+  // returns false at the end of the file
+  bool ReadChunk(Points& chunk, size_t max_rows);
+
+  // Starts reading from the beginning of the file again
+  void Rewind();
+
+  bool IsOpen() const { return file_.is_open(); }
+
+ private:
+  bool ParseLine(const std::string& line, DataType* values) const;
+
+  std::ifstream file_;
+  std::vector<size_t> columns_;
+  std::string line_;
+};
+
+}  // namespace clustering
+
+#endif  // CSV_CHUNKS_H
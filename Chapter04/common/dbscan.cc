@@ -0,0 +1,119 @@
+#include "dbscan.h"
+#include "radius_search.h"
+
+#include <atomic>
+#include <memory>
+
+namespace clustering {
+
+namespace {
+// Concurrent disjoint sets, roots are always the smallest indices of their
+// sets, so the final forest does not depend on the union order
+class UnionFind {
+ public:
+  explicit UnionFind(size_t size)
+      : parents_(new std::atomic<size_t>[size]) {
+    for (size_t i = 0; i < size; ++i)
+      parents_[i].store(i, std::memory_order_relaxed);
+  }
+
+  size_t Find(size_t x) {
+    while (true) {
+      auto parent = parents_[x].load(std::memory_order_relaxed);
+      if (parent == x)
+        return x;
+      // path halving
+      auto grand_parent = parents_[parent].load(std::memory_order_relaxed);
+      if (parent != grand_parent)
+        parents_[x].compare_exchange_weak(parent, grand_parent,
+                                          std::memory_order_relaxed);
+      x = grand_parent;
+    }
+  }
+
+  void Union(size_t a, size_t b) {
+    while (true) {
+      a = Find(a);
+      b = Find(b);
+      if (a == b)
+        return;
+      if (a < b)
+        std::swap(a, b);
+      // a is still a root only if nobody linked it meanwhile
+      auto expected = a;
+      if (parents_[a].compare_exchange_strong(expected, b,
+                                              std::memory_order_relaxed))
+        return;
+    }
+  }
+
+ private:
+  std::unique_ptr<std::atomic<size_t>[]> parents_;
+};
+}  // namespace
+
+DBSCANResult DBSCAN(PointsView points, const DBSCANOptions& options) {
+  const auto n = points.rows;
+  DBSCANResult result;
+  result.labels.assign(n, DBSCANResult::kNoise);
+  if (n == 0)
+    return result;
+
+  RadiusIndex index(points, options.eps);
+  // std::vector<bool> can not be written concurrently
+  std::vector<char> core(n, 0);
+#pragma omp parallel
+  {
+    std::vector<size_t> neighbors;
+#pragma omp for schedule(dynamic, 256)
+    for (size_t i = 0; i < n; ++i) {
+      index.Query(i, neighbors);
+      core[i] = neighbors.size() + 1 >= options.min_samples;
+    }
+  }
+
+  UnionFind sets(n);
+  // core sample to join for border samples
+  std::vector<size_t> border_links(n, DBSCANResult::kNoise);
+#pragma omp parallel
+  {
+    std::vector<size_t> neighbors;
+#pragma omp for schedule(dynamic, 256)
+    for (size_t i = 0; i < n; ++i) {
+      index.Query(i, neighbors);
+      if (core[i]) {
+        for (auto j : neighbors) {
+          if (j < i && core[j])
+            sets.Union(i, j);
+        }
+      } else {
+        for (auto j : neighbors) {
+          if (core[j] && j < border_links[i])
+            border_links[i] = j;
+        }
+      }
+    }
+  }
+
+  std::vector<size_t> root_labels(n, DBSCANResult::kNoise);
+  for (size_t i = 0; i < n; ++i) {
+    if (core[i]) {
+      auto root = sets.Find(i);
+      if (root_labels[root] == DBSCANResult::kNoise)
+        root_labels[root] = result.num_clusters++;
+      result.labels[i] = root_labels[root];
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (!core[i]) {
+      if (border_links[i] != DBSCANResult::kNoise)
+        result.labels[i] = result.labels[border_links[i]];
+      else
+        ++result.num_noise;
+    }
+  }
+  result.core.assign(core.begin(), core.end());
+  return result;
+}
+
+}  // namespace clustering
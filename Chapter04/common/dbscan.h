@@ -0,0 +1,37 @@
+#ifndef DBSCAN_H
+#define DBSCAN_H
+
+#include "points.h"
+
+#include <limits>
+#include <vector>
+
+namespace clustering {
+
+struct DBSCANOptions {
+  DataType eps{0.3};  // neighborhood radius
+  // neighbors (the sample itself included) which make a sample a core one
+  size_t min_samples{5};
+};
+
+struct DBSCANResult {
+  static constexpr size_t kNoise = std::numeric_limits<size_t>::max();
+
+  std::vector<size_t> labels;  // cluster index or kNoise
+  std::vector<bool> core;
+  size_t num_clusters{0};
+  size_t num_noise{0};
+};
+
+// DBSCAN over the RadiusIndex, so neighborhoods come from a grid or a KD-tree
+// instead of all pairwise distances. Core samples are detected in parallel,
+// then neighboring core samples are merged in parallel with a lock-free
+// union-find which always links the larger root to the smaller one. Border
+// samples join the cluster of their first core neighbor. Clusters are
+// numbered in the order of their first samples, so labels do not depend on
+// the threads number.
+DBSCANResult DBSCAN(PointsView points, const DBSCANOptions& options = {});
+
+}  // namespace clustering
+
+#endif  // DBSCAN_H
@@ -0,0 +1,445 @@
+#include "gmm.h"
+#include "kmeans.h"
+#include "kmeans_init.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace clustering {
+
+namespace {
+const size_t kBlockSize = 1024;
+// statistics are merged from that many sample ranges
+const size_t kPartitions = 64;
+const DataType kLog2Pi = std::log(2 * 3.14159265358979323846);
+const size_t kMaxCholeskyAttempts = 10;
+
+// In-place Cholesky factorization of the row-major symmetric matrix, the lower
+// triangle gets the factor. Returns false if the matrix is not positive
+// definite.
+bool CholeskyDecompose(DataType* a, size_t n) {
+  for (size_t j = 0; j < n; ++j) {
+    auto* row_j = a + j * n;
+    auto diag = row_j[j];
+    for (size_t k = 0; k < j; ++k)
+      diag -= row_j[k] * row_j[k];
+    if (!(diag > 0))
+      return false;
+    row_j[j] = std::sqrt(diag);
+    for (size_t i = j + 1; i < n; ++i) {
+      auto* row_i = a + i * n;
+      auto value = row_i[j];
+      for (size_t k = 0; k < j; ++k)
+        value -= row_i[k] * row_j[k];
+      row_i[j] = value / row_j[j];
+    }
+    std::fill(row_j + j + 1, row_j + n, 0);
+  }
+  return true;
+}
+
+// Per-dimension variances of all samples, the initial covariance of
+// components which get no samples from k-means
+std::vector<DataType> Variances(PointsView points) {
+  std::vector<DataType> mean(points.cols, 0);
+  std::vector<DataType> m2(points.cols, 0);
+  for (size_t i = 0; i < points.rows; ++i) {
+    const auto* point = points[i];
+    for (size_t j = 0; j < points.cols; ++j) {
+      auto delta = point[j] - mean[j];
+      mean[j] += delta / static_cast<DataType>(i + 1);
+      m2[j] += delta * (point[j] - mean[j]);
+    }
+  }
+  for (auto& value : m2)
+    value /= static_cast<DataType>(points.rows);
+  return m2;
+}
+}  // namespace
+
+struct GaussianMixture::Scratch {
+  Scratch(size_t num_components, size_t dims)
+      : log_prob(num_components * kBlockSize),
+        diff(dims * kBlockSize),
+        max(kBlockSize),
+        sum(kBlockSize) {}
+
+  std::vector<DataType> log_prob;  // then responsibilities
+  std::vector<DataType> diff;      // dims x block size
+  std::vector<DataType> max;
+  std::vector<DataType> sum;
+};
+
+struct GaussianMixture::Statistics {
+  Statistics(size_t num_components, size_t dims, bool full)
+      : counts(num_components, 0),
+        sums(num_components * dims, 0),
+        scatter(num_components * dims * (full ? dims : 1), 0) {}
+
+  void Add(const Statistics& other) {
+    for (size_t i = 0; i < counts.size(); ++i)
+      counts[i] += other.counts[i];
+    for (size_t i = 0; i < sums.size(); ++i)
+      sums[i] += other.sums[i];
+    for (size_t i = 0; i < scatter.size(); ++i)
+      scatter[i] += other.scatter[i];
+    log_likelihood += other.log_likelihood;
+  }
+
+  std::vector<DataType> counts;
+  std::vector<DataType> sums;     // of the differences from the means
+  std::vector<DataType> scatter;  // lower triangles or diagonals
+  DataType log_likelihood{0};
+};
+
+GaussianMixture::GaussianMixture(size_t num_components,
+                                 const GMMOptions& options)
+    : num_components_(num_components), options_(options) {}
+
+void GaussianMixture::EstimateLogProb(PointsView points,
+                                      size_t begin,
+                                      size_t end,
+                                      Scratch& scratch) const {
+  const auto m = end - begin;
+  auto* diff = scratch.diff.data();
+  const bool full = options_.covariance_type == CovarianceType::Full;
+  for (size_t c = 0; c < num_components_; ++c) {
+    const auto* mean = means_[c];
+    const auto* factor = cholesky_[c];
+    for (size_t b = 0; b < m; ++b) {
+      const auto* point = points[begin + b];
+      for (size_t j = 0; j < dims_; ++j)
+        diff[j * m + b] = point[j] - mean[j];
+    }
+    // whitening: forward substitution with the Cholesky factor
+    for (size_t j = 0; j < dims_; ++j) {
+      auto* diff_j = diff + j * m;
+      if (full) {
+        const auto* row = factor + j * dims_;
+        for (size_t i = 0; i < j; ++i) {
+          const auto l = row[i];
+          const auto* diff_i = diff + i * m;
+#pragma omp simd
+          for (size_t b = 0; b < m; ++b)
+            diff_j[b] -= l * diff_i[b];
+        }
+      }
+      const auto inv = 1 / (full ? factor[j * dims_ + j] : factor[j]);
+#pragma omp simd
+      for (size_t b = 0; b < m; ++b)
+        diff_j[b] *= inv;
+    }
+    auto* log_prob = scratch.log_prob.data() + c * m;
+    std::fill_n(log_prob, m, log_norm_[c]);
+    for (size_t j = 0; j < dims_; ++j) {
+      const auto* diff_j = diff + j * m;
+#pragma omp simd
+      for (size_t b = 0; b < m; ++b)
+        log_prob[b] -= DataType(0.5) * diff_j[b] * diff_j[b];
+    }
+  }
+}
+
+DataType GaussianMixture::Normalize(size_t block_size,
+                                    Scratch& scratch) const {
+  const auto m = block_size;
+  auto* log_prob = scratch.log_prob.data();
+  auto* max = scratch.max.data();
+  auto* sum = scratch.sum.data();
+  std::fill_n(max, m, -std::numeric_limits<DataType>::infinity());
+  std::fill_n(sum, m, 0);
+  for (size_t c = 0; c < num_components_; ++c) {
+    const auto* lp = log_prob + c * m;
+#pragma omp simd
+    for (size_t b = 0; b < m; ++b)
+      max[b] = std::max(max[b], lp[b]);
+  }
+  for (size_t c = 0; c < num_components_; ++c) {
+    auto* lp = log_prob + c * m;
+    for (size_t b = 0; b < m; ++b) {
+      lp[b] = std::exp(lp[b] - max[b]);
+      sum[b] += lp[b];
+    }
+  }
+  DataType log_likelihood = 0;
+  for (size_t b = 0; b < m; ++b) {
+    log_likelihood += max[b] + std::log(sum[b]);
+    sum[b] = 1 / sum[b];
+  }
+  for (size_t c = 0; c < num_components_; ++c) {
+    auto* lp = log_prob + c * m;
+#pragma omp simd
+    for (size_t b = 0; b < m; ++b)
+      lp[b] *= sum[b];
+  }
+  return log_likelihood;
+}
+
+void GaussianMixture::Accumulate(PointsView points,
+                                 size_t begin,
+                                 size_t end,
+                                 Scratch& scratch,
+                                 Statistics& stats) const {
+  const auto m = end - begin;
+  auto* diff = scratch.diff.data();
+  const bool full = options_.covariance_type == CovarianceType::Full;
+  for (size_t c = 0; c < num_components_; ++c) {
+    const auto* resp = scratch.log_prob.data() + c * m;
+    const auto* mean = means_[c];
+    for (size_t b = 0; b < m; ++b) {
+      const auto* point = points[begin + b];
+      for (size_t j = 0; j < dims_; ++j)
+        diff[j * m + b] = point[j] - mean[j];
+    }
+
+    DataType count = 0;
+#pragma omp simd reduction(+ : count)
+    for (size_t b = 0; b < m; ++b)
+      count += resp[b];
+    stats.counts[c] += count;
+
+    auto* sums = &stats.sums[c * dims_];
+    auto* scatter = &stats.scatter[c * dims_ * (full ? dims_ : 1)];
+    for (size_t i = 0; i < dims_; ++i) {
+      const auto* diff_i = diff + i * m;
+      DataType sum = 0;
+#pragma omp simd reduction(+ : sum)
+      for (size_t b = 0; b < m; ++b)
+        sum += resp[b] * diff_i[b];
+      sums[i] += sum;
+      const auto last = full ? i : 0;
+      for (size_t j = 0; j <= last; ++j) {
+        const auto* diff_j = full ? diff + j * m : diff_i;
+        DataType product = 0;
+#pragma omp simd reduction(+ : product)
+        for (size_t b = 0; b < m; ++b)
+          product += resp[b] * diff_i[b] * diff_j[b];
+        scatter[full ? i * dims_ + j : i] += product;
+      }
+    }
+  }
+}
+
+template <typename BlockFn>
+GaussianMixture::Statistics GaussianMixture::Reduce(PointsView points,
+                                                    BlockFn&& block_fn) const {
+  const bool full = options_.covariance_type == CovarianceType::Full;
+  const auto blocks_num = (points.rows + kBlockSize - 1) / kBlockSize;
+  const auto partitions_num = std::max<size_t>(
+      1, std::min(kPartitions, blocks_num));
+  std::vector<Statistics> partitions(
+      partitions_num, Statistics(num_components_, dims_, full));
+#pragma omp parallel
+  {
+    Scratch scratch(num_components_, dims_);
+#pragma omp for schedule(dynamic)
+    for (size_t p = 0; p < partitions_num; ++p) {
+      auto first_block = p * blocks_num / partitions_num;
+      auto last_block = (p + 1) * blocks_num / partitions_num;
+      for (auto block = first_block; block < last_block; ++block) {
+        auto begin = block * kBlockSize;
+        auto end = std::min(points.rows, begin + kBlockSize);
+        block_fn(begin, end, scratch, partitions[p]);
+      }
+    }
+  }
+  for (size_t p = 1; p < partitions_num; ++p)
+    partitions[0].Add(partitions[p]);
+  return std::move(partitions[0]);
+}
+
+void GaussianMixture::MaximizationStep(const Statistics& stats,
+                                       size_t num_samples) {
+  const bool full = options_.covariance_type == CovarianceType::Full;
+  const auto reg = options_.regularization;
+  for (size_t c = 0; c < num_components_; ++c) {
+    weights_[c] = stats.counts[c] / num_samples;
+    // an empty component keeps its parameters
+    if (stats.counts[c] < std::numeric_limits<DataType>::epsilon())
+      continue;
+    const auto* sums = &stats.sums[c * dims_];
+    const auto* scatter = &stats.scatter[c * dims_ * (full ? dims_ : 1)];
+    auto* mean = means_[c];
+    auto* cov = covariances_[c];
+    // statistics are centered at the old mean, shift them to the new one
+    std::vector<DataType> shift(dims_);
+    for (size_t j = 0; j < dims_; ++j) {
+      shift[j] = sums[j] / stats.counts[c];
+      mean[j] += shift[j];
+    }
+    if (full) {
+      for (size_t i = 0; i < dims_; ++i) {
+        for (size_t j = 0; j <= i; ++j) {
+          auto value =
+              scatter[i * dims_ + j] / stats.counts[c] - shift[i] * shift[j];
+          cov[i * dims_ + j] = value;
+          cov[j * dims_ + i] = value;
+        }
+        cov[i * dims_ + i] += reg;
+      }
+    } else {
+      for (size_t j = 0; j < dims_; ++j)
+        cov[j] = std::max(scatter[j] / stats.counts[c] - shift[j] * shift[j],
+                          DataType(0)) +
+                 reg;
+    }
+  }
+  UpdateCholesky();
+}
+
+void GaussianMixture::UpdateCholesky() {
+  const bool full = options_.covariance_type == CovarianceType::Full;
+  for (size_t c = 0; c < num_components_; ++c) {
+    auto* factor = cholesky_[c];
+    const auto* cov = covariances_[c];
+    DataType log_det = 0;
+    if (full) {
+      // add a growing diagonal load until the factorization succeeds
+      auto jitter = options_.regularization;
+      std::copy_n(cov, dims_ * dims_, factor);
+      for (size_t attempt = 0;
+           !CholeskyDecompose(factor, dims_) && attempt < kMaxCholeskyAttempts;
+           ++attempt) {
+        std::copy_n(cov, dims_ * dims_, factor);
+        for (size_t j = 0; j < dims_; ++j)
+          factor[j * dims_ + j] += jitter;
+        jitter *= 10;
+      }
+      for (size_t j = 0; j < dims_; ++j)
+        log_det += 2 * std::log(factor[j * dims_ + j]);
+    } else {
+      for (size_t j = 0; j < dims_; ++j) {
+        auto variance = std::max(cov[j], options_.regularization);
+        factor[j] = std::sqrt(variance);
+        log_det += std::log(variance);
+      }
+    }
+    // an empty component gets no responsibilities
+    log_norm_[c] = weights_[c] > 0
+                       ? std::log(weights_[c]) - DataType(0.5) * log_det -
+                             DataType(0.5) * dims_ * kLog2Pi
+                       : -std::numeric_limits<DataType>::infinity();
+  }
+}
+
+void GaussianMixture::Fit(PointsView points) {
+  const auto n = points.rows;
+  const auto k = num_components_;
+  dims_ = points.cols;
+  const bool full = options_.covariance_type == CovarianceType::Full;
+  const auto cov_size = full ? dims_ * dims_ : dims_;
+  weights_.assign(k, 0);
+  covariances_ = Points(k, cov_size);
+  cholesky_ = Points(k, cov_size);
+  log_norm_.assign(k, 0);
+  iterations_ = 0;
+  log_likelihood_ = 0;
+  converged_ = false;
+  if (n == 0 || k == 0)
+    return;
+
+  // responsibilities start from the hard k-means assignment
+  KMeansParallelOptions init_options;
+  init_options.seed = options_.seed;
+  auto kmeans = KMeans(points, KMeansParallelInit(points, k, init_options));
+  means_ = kmeans.centers;
+  // kept by the components k-means leaves empty
+  auto variances = Variances(points);
+  for (size_t c = 0; c < k; ++c) {
+    for (size_t j = 0; j < dims_; ++j) {
+      covariances_[c][full ? j * dims_ + j : j] =
+          variances[j] + options_.regularization;
+    }
+  }
+  MaximizationStep(
+      Reduce(points,
+             [&](size_t begin, size_t end, Scratch& scratch,
+                 Statistics& stats) {
+               const auto m = end - begin;
+               std::fill_n(scratch.log_prob.begin(), k * m, 0);
+               for (size_t b = 0; b < m; ++b)
+                 scratch.log_prob[kmeans.labels[begin + b] * m + b] = 1;
+               Accumulate(points, begin, end, scratch, stats);
+             }),
+      n);
+
+  for (iterations_ = 0; iterations_ < options_.max_iterations;) {
+    auto stats = Reduce(points, [&](size_t begin, size_t end, Scratch& scratch,
+                                    Statistics& stats) {
+      EstimateLogProb(points, begin, end, scratch);
+      stats.log_likelihood += Normalize(end - begin, scratch);
+      Accumulate(points, begin, end, scratch, stats);
+    });
+    MaximizationStep(stats, n);
+    ++iterations_;
+    auto log_likelihood = stats.log_likelihood / n;
+    auto change = std::abs(log_likelihood - log_likelihood_);
+    log_likelihood_ = log_likelihood;
+    if (iterations_ > 1 && change < options_.tolerance) {
+      converged_ = true;
+      break;
+    }
+  }
+}
+
+std::vector<size_t> GaussianMixture::Predict(PointsView points) const {
+  std::vector<size_t> labels(points.rows);
+  const auto blocks_num = (points.rows + kBlockSize - 1) / kBlockSize;
+#pragma omp parallel
+  {
+    Scratch scratch(num_components_, dims_);
+#pragma omp for schedule(static)
+    for (size_t block = 0; block < blocks_num; ++block) {
+      auto begin = block * kBlockSize;
+      auto end = std::min(points.rows, begin + kBlockSize);
+      const auto m = end - begin;
+      EstimateLogProb(points, begin, end, scratch);
+      const auto* log_prob = scratch.log_prob.data();
+      for (size_t b = 0; b < m; ++b) {
+        size_t best = 0;
+        for (size_t c = 1; c < num_components_; ++c) {
+          if (log_prob[c * m + b] > log_prob[best * m + b])
+            best = c;
+        }
+        labels[begin + b] = best;
+      }
+    }
+  }
+  return labels;
+}
+
+Points GaussianMixture::PredictProba(PointsView points) const {
+  Points proba(points.rows, num_components_);
+  const auto blocks_num = (points.rows + kBlockSize - 1) / kBlockSize;
+#pragma omp parallel
+  {
+    Scratch scratch(num_components_, dims_);
+#pragma omp for schedule(static)
+    for (size_t block = 0; block < blocks_num; ++block) {
+      auto begin = block * kBlockSize;
+      auto end = std::min(points.rows, begin + kBlockSize);
+      const auto m = end - begin;
+      EstimateLogProb(points, begin, end, scratch);
+      Normalize(m, scratch);
+      for (size_t b = 0; b < m; ++b) {
+        for (size_t c = 0; c < num_components_; ++c)
+          proba[begin + b][c] = scratch.log_prob[c * m + b];
+      }
+    }
+  }
+  return proba;
+}
+
+DataType GaussianMixture::Score(PointsView points) const {
+  if (points.rows == 0)
+    return 0;
+  auto stats = Reduce(points, [&](size_t begin, size_t end, Scratch& scratch,
+                                  Statistics& stats) {
+    EstimateLogProb(points, begin, end, scratch);
+    stats.log_likelihood += Normalize(end - begin, scratch);
+  });
+  return stats.log_likelihood / points.rows;
+}
+
+}  // namespace clustering
@@ -0,0 +1,95 @@
+#ifndef GMM_H
+#define GMM_H
+
+#include "points.h"
+
+#include <vector>
+
+namespace clustering {
+
+enum class CovarianceType {
+  Full,     // d x d matrix per component
+  Diagonal  // d variances per component
+};
+
+struct GMMOptions {
+  CovarianceType covariance_type{CovarianceType::Full};
+  size_t max_iterations{100};
+  // stop when the mean log-likelihood per sample changes less than that
+  DataType tolerance{1e-6};
+  // added to the covariance diagonal to keep it positive definite
+  DataType regularization{1e-6};
+  unsigned seed{0};
+};
+
+// Gaussian mixture model trained with EM. Parameters are initialized from
+// k-means|| seeded k-means. Covariances are kept as Cholesky factors, so the
+// E-step needs only triangular solves. Samples are processed in blocks, the
+// log densities of a block are computed for all samples at once with SIMD
+// over samples and normalized with log-sum-exp. The M-step statistics are
+// accumulated in parallel in a fixed number of partitions merged in order,
+// so results do not depend on the threads number.
+class GaussianMixture {
+ public:
+  explicit GaussianMixture(size_t num_components,
+                           const GMMOptions& options = {});
+
+  void Fit(PointsView points);
+
+  // Most probable component of every sample
+  std::vector<size_t> Predict(PointsView points) const;
+
+  // Component probabilities, one row per sample
+  Points PredictProba(PointsView points) const;
+
+  // Mean log-likelihood per sample
+  DataType Score(PointsView points) const;
+
+  const std::vector<DataType>& GetWeights() const { return weights_; }
+  const Points& GetMeans() const { return means_; }
+  // One row per component, d x d row-major matrices or d variances
+  const Points& GetCovariances() const { return covariances_; }
+  size_t GetIterations() const { return iterations_; }
+  DataType GetLogLikelihood() const { return log_likelihood_; }
+  bool IsConverged() const { return converged_; }
+
+ private:
+  struct Scratch;
+  struct Statistics;
+
+  // Weighted log densities of the samples [begin, end) for all components,
+  // scratch.log_prob[c * block_size + b]
+  void EstimateLogProb(PointsView points,
+                       size_t begin,
+                       size_t end,
+                       Scratch& scratch) const;
+  // Turns the block log densities into responsibilities in place, returns
+  // the block log-likelihood
+  DataType Normalize(size_t block_size, Scratch& scratch) const;
+  // Adds responsibility weighted statistics centered at the current means
+  void Accumulate(PointsView points,
+                  size_t begin,
+                  size_t end,
+                  Scratch& scratch,
+                  Statistics& stats) const;
+  template <typename BlockFn>
+  Statistics Reduce(PointsView points, BlockFn&& block_fn) const;
+  void MaximizationStep(const Statistics& stats, size_t num_samples);
+  void UpdateCholesky();
+
+  size_t num_components_;
+  GMMOptions options_;
+  size_t dims_{0};
+  std::vector<DataType> weights_;
+  Points means_;
+  Points covariances_;
+  Points cholesky_;                  // lower factors or standard deviations
+  std::vector<DataType> log_norm_;   // log weight - log det / 2 - d log 2pi / 2
+  size_t iterations_{0};
+  DataType log_likelihood_{0};
+  bool converged_{false};
+};
+
+}  // namespace clustering
+
+#endif  // GMM_H
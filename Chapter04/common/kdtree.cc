@@ -0,0 +1,99 @@
+#include "kdtree.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace clustering {
+
+KDTree::KDTree(PointsView points, size_t leaf_size)
+    : points_(points), leaf_size_(std::max<size_t>(leaf_size, 1)) {
+  order_.resize(points_.rows);
+  std::iota(order_.begin(), order_.end(), 0);
+  if (points_.rows > 0)
+    BuildNode(0, points_.rows);
+}
+
+int32_t KDTree::BuildNode(size_t begin, size_t end) {
+  auto node_idx = static_cast<int32_t>(nodes_.size());
+  nodes_.emplace_back();
+  nodes_[node_idx].begin = begin;
+  nodes_[node_idx].end = end;
+  if (end - begin <= leaf_size_)
+    return node_idx;
+
+  // split along the widest dimension of the node
+  size_t split_dim = 0;
+  DataType max_extent = -1;
+  for (size_t d = 0; d < points_.cols; ++d) {
+    auto [min_it, max_it] = std::minmax_element(
+        order_.begin() + begin, order_.begin() + end,
+        [&](size_t a, size_t b) { return points_[a][d] < points_[b][d]; });
+    auto extent = points_[*max_it][d] - points_[*min_it][d];
+    if (extent > max_extent) {
+      max_extent = extent;
+      split_dim = d;
+    }
+  }
+  if (max_extent <= 0)
+    return node_idx;  // all samples are equal
+
+  auto mid = begin + (end - begin) / 2;
+  std::nth_element(order_.begin() + begin, order_.begin() + mid,
+                   order_.begin() + end, [&](size_t a, size_t b) {
+                     return points_[a][split_dim] < points_[b][split_dim];
+                   });
+  auto split_value = points_[order_[mid]][split_dim];
+  auto left = BuildNode(begin, mid);
+  auto right = BuildNode(mid, end);
+  auto& node = nodes_[node_idx];
+  node.split_dim = split_dim;
+  node.split_value = split_value;
+  node.left = left;
+  node.right = right;
+  return node_idx;
+}
+
+void KDTree::KNearest(size_t i,
+                      size_t k,
+                      std::vector<Neighbor>& neighbors) const {
+  neighbors.clear();
+  if (k == 0 || nodes_.empty())
+    return;
+  neighbors.reserve(k + 1);
+  // neighbors is kept as a max heap while searching
+  KNearest(0, i, k, neighbors);
+  std::sort_heap(neighbors.begin(), neighbors.end());
+}
+
+void KDTree::KNearest(int32_t node_idx,
+                      size_t i,
+                      size_t k,
+                      std::vector<Neighbor>& heap) const {
+  const auto& node = nodes_[node_idx];
+  if (node.left < 0) {
+    for (auto n = node.begin; n != node.end; ++n) {
+      auto j = order_[n];
+      if (j == i)
+        continue;
+      Neighbor candidate{SquaredDistance(points_[i], points_[j], points_.cols),
+                         j};
+      if (heap.size() < k) {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end());
+      } else if (candidate < heap.front()) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+    return;
+  }
+  auto diff = points_[i][node.split_dim] - node.split_value;
+  auto near = diff < 0 ? node.left : node.right;
+  auto far = diff < 0 ? node.right : node.left;
+  KNearest(near, i, k, heap);
+  if (heap.size() < k || diff * diff < heap.front().first)
+    KNearest(far, i, k, heap);
+}
+
+}  // namespace clustering
@@ -0,0 +1,81 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include "points.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace clustering {
+
+// Distance to a neighbor and its sample index
+using Neighbor = std::pair<DataType, size_t>;
+
+// KD-tree over samples of a PointsView, nodes are split at the median of the
+// widest dimension. The view has to outlive the tree.
+class KDTree {
+ public:
+  explicit KDTree(PointsView points, size_t leaf_size = 16);
+
+  // Calls f(j, squared_distance) for every sample j != i closer than radius
+  template <typename F>
+  void ForEachInRadius(size_t i, DataType radius, F&& f) const {
+    if (!nodes_.empty())
+      ForEachInRadius(0, i, radius, radius * radius, f);
+  }
+
+  // The k nearest samples to sample i (i itself excluded), ordered by
+  // squared distance
+  void KNearest(size_t i, size_t k, std::vector<Neighbor>& neighbors) const;
+
+ private:
+  struct Node {
+    size_t begin{0};  // range in order_
+    size_t end{0};
+    size_t split_dim{0};
+    DataType split_value{0};
+    int32_t left{-1};
+    int32_t right{-1};
+  };
+
+  int32_t BuildNode(size_t begin, size_t end);
+  void KNearest(int32_t node_idx,
+                size_t i,
+                size_t k,
+                std::vector<Neighbor>& heap) const;
+
+  template <typename F>
+  void ForEachInRadius(int32_t node_idx,
+                       size_t i,
+                       DataType radius,
+                       DataType radius_sq,
+                       F& f) const {
+    const auto& node = nodes_[node_idx];
+    if (node.left < 0) {
+      for (auto k = node.begin; k != node.end; ++k) {
+        auto j = order_[k];
+        if (j == i)
+          continue;
+        auto dist_sq = SquaredDistance(points_[i], points_[j], points_.cols);
+        if (dist_sq < radius_sq)
+          f(j, dist_sq);
+      }
+      return;
+    }
+    auto diff = points_[i][node.split_dim] - node.split_value;
+    if (diff < radius)
+      ForEachInRadius(node.left, i, radius, radius_sq, f);
+    if (-diff < radius)
+      ForEachInRadius(node.right, i, radius, radius_sq, f);
+  }
+
+  PointsView points_;
+  size_t leaf_size_;
+  std::vector<size_t> order_;  // sample indices sorted by leaf
+  std::vector<Node> nodes_;
+};
+
+}  // namespace clustering
+
+#endif  // KDTREE_H
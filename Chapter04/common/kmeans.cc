@@ -0,0 +1,367 @@
+#include "kmeans.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace clustering {
+
+namespace {
+const size_t kBlockSize = 1024;
+const size_t kMaxHamerlyClusters = 20;
+
+class KMeansSolver {
+ public:
+  KMeansSolver(PointsView points, Points centers, KMeansAlgorithm algorithm);
+
+  KMeansResult Run(size_t max_iterations);
+
+ private:
+  struct BlockState {
+    std::vector<DataType> sums;  // k x dims
+    std::vector<size_t> counts;
+    std::vector<DataType> dist;  // scratch for distances to all centers
+    size_t distances{0};
+    size_t skipped{0};  // distances a Lloyd iteration would compute
+    size_t changed{0};
+  };
+
+  void UpdateCentersGeometry();
+  void AssignBlock(size_t block, bool first_iteration);
+  bool AssignLloyd(size_t i, const DataType* point, BlockState& state);
+  bool AssignHamerly(size_t i, const DataType* point, BlockState& state);
+  bool AssignElkan(size_t i, const DataType* point, BlockState& state);
+  void UpdateCenters();
+  void UpdateBounds();
+
+  // squared distances from a point to all centers, vectorized over centers
+  void DistancesToCenters(const DataType* point, DataType* dist) const {
+    std::fill_n(dist, k_, 0);
+    for (size_t d = 0; d < dims_; ++d) {
+      const auto x = point[d];
+      const auto* center_coords = &centers_t_[d * k_];
+#pragma omp simd
+      for (size_t c = 0; c < k_; ++c) {
+        auto diff = x - center_coords[c];
+        dist[c] += diff * diff;
+      }
+    }
+  }
+
+  DataType DistanceToCenter(const DataType* point, size_t c) const {
+    return std::sqrt(SquaredDistance(point, centers_[c], dims_));
+  }
+
+  size_t n_;
+  size_t dims_;
+  size_t k_;
+  KMeansAlgorithm algorithm_;
+  // samples in the structure of arrays layout, soa_[d * n_ + i]
+  std::vector<DataType> soa_;
+  Points centers_;
+  std::vector<DataType> centers_t_;  // centers_t_[d * k_ + c]
+  std::vector<size_t> labels_;
+
+  // bounds state
+  std::vector<DataType> upper_;
+  std::vector<DataType> lower_;          // n for Hamerly, n x k for Elkan
+  std::vector<DataType> center_dists_;   // k x k
+  std::vector<DataType> half_min_dist_;  // to the closest other center
+  std::vector<DataType> moves_;
+
+  std::vector<BlockState> blocks_;
+};
+
+KMeansSolver::KMeansSolver(PointsView points,
+                           Points centers,
+                           KMeansAlgorithm algorithm)
+    : n_(points.rows),
+      dims_(points.cols),
+      k_(centers.rows),
+      algorithm_(algorithm),
+      centers_(std::move(centers)) {
+  if (algorithm_ == KMeansAlgorithm::Auto)
+    algorithm_ = k_ <= kMaxHamerlyClusters ? KMeansAlgorithm::Hamerly
+                                           : KMeansAlgorithm::Elkan;
+  soa_.resize(n_ * dims_);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n_; ++i)
+    for (size_t d = 0; d < dims_; ++d)
+      soa_[d * n_ + i] = points[i][d];
+
+  labels_.assign(n_, k_);  // no cluster
+  upper_.resize(n_);
+  if (algorithm_ == KMeansAlgorithm::Hamerly)
+    lower_.resize(n_);
+  else if (algorithm_ == KMeansAlgorithm::Elkan)
+    lower_.resize(n_ * k_);
+  centers_t_.resize(k_ * dims_);
+  center_dists_.resize(k_ * k_);
+  half_min_dist_.resize(k_);
+  moves_.resize(k_);
+  blocks_.resize((n_ + kBlockSize - 1) / kBlockSize);
+}
+
+KMeansResult KMeansSolver::Run(size_t max_iterations) {
+  KMeansResult result;
+  for (size_t iteration = 0; iteration < max_iterations; ++iteration) {
+    UpdateCentersGeometry();
+#pragma omp parallel for schedule(dynamic)
+    for (size_t b = 0; b < blocks_.size(); ++b)
+      AssignBlock(b, iteration == 0);
+
+    size_t changed = 0;
+    for (auto& block : blocks_) {
+      changed += block.changed;
+      result.distances += block.distances;
+      result.skipped_distances += block.skipped;
+    }
+    ++result.iterations;
+    // the centers already are the means of unchanged clusters
+    if (changed == 0) {
+      result.converged = true;
+      break;
+    }
+    UpdateCenters();
+    UpdateBounds();
+  }
+
+  DataType inertia = 0;
+#pragma omp parallel for reduction(+ : inertia) schedule(static)
+  for (size_t i = 0; i < n_; ++i) {
+    for (size_t d = 0; d < dims_; ++d) {
+      auto diff = soa_[d * n_ + i] - centers_[labels_[i]][d];
+      inertia += diff * diff;
+    }
+  }
+  result.inertia = inertia;
+  result.centers = std::move(centers_);
+  result.labels = std::move(labels_);
+  return result;
+}
+
+void KMeansSolver::UpdateCentersGeometry() {
+  for (size_t c = 0; c < k_; ++c)
+    for (size_t d = 0; d < dims_; ++d)
+      centers_t_[d * k_ + c] = centers_[c][d];
+  if (algorithm_ == KMeansAlgorithm::Lloyd)
+    return;
+
+  std::fill(half_min_dist_.begin(), half_min_dist_.end(),
+            std::numeric_limits<DataType>::max());
+  for (size_t c1 = 0; c1 < k_; ++c1) {
+    center_dists_[c1 * k_ + c1] = 0;
+    for (size_t c2 = c1 + 1; c2 < k_; ++c2) {
+      auto dist =
+          std::sqrt(SquaredDistance(centers_[c1], centers_[c2], dims_));
+      center_dists_[c1 * k_ + c2] = dist;
+      center_dists_[c2 * k_ + c1] = dist;
+      half_min_dist_[c1] = std::min(half_min_dist_[c1], dist / 2);
+      half_min_dist_[c2] = std::min(half_min_dist_[c2], dist / 2);
+    }
+  }
+}
+
+void KMeansSolver::AssignBlock(size_t block, bool first_iteration) {
+  auto& state = blocks_[block];
+  state.sums.assign(k_ * dims_, 0);
+  state.counts.assign(k_, 0);
+  state.dist.resize(k_);
+  state.distances = 0;
+  state.skipped = 0;
+  state.changed = 0;
+
+  std::vector<DataType> point(dims_);
+  auto end = std::min(n_, (block + 1) * kBlockSize);
+  for (auto i = block * kBlockSize; i < end; ++i) {
+    for (size_t d = 0; d < dims_; ++d)
+      point[d] = soa_[d * n_ + i];
+
+    bool changed = false;
+    if (first_iteration || algorithm_ == KMeansAlgorithm::Lloyd)
+      changed = AssignLloyd(i, point.data(), state);
+    else if (algorithm_ == KMeansAlgorithm::Hamerly)
+      changed = AssignHamerly(i, point.data(), state);
+    else
+      changed = AssignElkan(i, point.data(), state);
+    if (changed)
+      ++state.changed;
+
+    auto* sums = &state.sums[labels_[i] * dims_];
+    for (size_t d = 0; d < dims_; ++d)
+      sums[d] += point[d];
+    ++state.counts[labels_[i]];
+  }
+}
+
+bool KMeansSolver::AssignLloyd(size_t i,
+                               const DataType* point,
+                               BlockState& state) {
+  auto& dist = state.dist;
+  DistancesToCenters(point, dist.data());
+  state.distances += k_;
+
+  size_t best = 0;
+  for (size_t c = 1; c < k_; ++c)
+    if (dist[c] < dist[best])
+      best = c;
+  upper_[i] = std::sqrt(dist[best]);
+  if (algorithm_ == KMeansAlgorithm::Hamerly) {
+    auto second = std::numeric_limits<DataType>::max();
+    for (size_t c = 0; c < k_; ++c)
+      if (c != best)
+        second = std::min(second, dist[c]);
+    lower_[i] = std::sqrt(second);
+  } else if (algorithm_ == KMeansAlgorithm::Elkan) {
+    for (size_t c = 0; c < k_; ++c)
+      lower_[i * k_ + c] = std::sqrt(dist[c]);
+  }
+
+  bool changed = labels_[i] != best;
+  labels_[i] = best;
+  return changed;
+}
+
+bool KMeansSolver::AssignHamerly(size_t i,
+                                 const DataType* point,
+                                 BlockState& state) {
+  auto a = labels_[i];
+  auto bound = std::max(half_min_dist_[a], lower_[i]);
+  if (upper_[i] <= bound) {
+    state.skipped += k_;
+    return false;
+  }
+  // tighten the upper bound first, it is often enough
+  upper_[i] = DistanceToCenter(point, a);
+  ++state.distances;
+  if (upper_[i] <= bound) {
+    state.skipped += k_ - 1;
+    return false;
+  }
+  // one distance more than Lloyd computes, none is skipped
+  return AssignLloyd(i, point, state);
+}
+
+bool KMeansSolver::AssignElkan(size_t i,
+                               const DataType* point,
+                               BlockState& state) {
+  auto a = labels_[i];
+  if (upper_[i] <= half_min_dist_[a]) {
+    state.skipped += k_;
+    return false;
+  }
+
+  auto* lower = &lower_[i * k_];
+  bool tight = false;
+  // at most one distance to every center is computed
+  const auto computed = state.distances;
+  for (size_t c = 0; c < k_; ++c) {
+    if (c == a)
+      continue;
+    auto bound = std::max(lower[c], center_dists_[a * k_ + c] / 2);
+    if (upper_[i] <= bound)
+      continue;
+    if (!tight) {
+      upper_[i] = DistanceToCenter(point, a);
+      lower[a] = upper_[i];
+      ++state.distances;
+      tight = true;
+      if (upper_[i] <= bound)
+        continue;
+    }
+    auto dist = DistanceToCenter(point, c);
+    ++state.distances;
+    lower[c] = dist;
+    if (dist < upper_[i]) {
+      a = c;
+      upper_[i] = dist;
+    }
+  }
+
+  state.skipped += k_ - (state.distances - computed);
+  bool changed = labels_[i] != a;
+  labels_[i] = a;
+  return changed;
+}
+
+void KMeansSolver::UpdateCenters() {
+  for (size_t c = 0; c < k_; ++c) {
+    std::vector<DataType> sum(dims_, 0);
+    size_t count = 0;
+    for (auto& block : blocks_) {
+      for (size_t d = 0; d < dims_; ++d)
+        sum[d] += block.sums[c * dims_ + d];
+      count += block.counts[c];
+    }
+    if (count == 0) {
+      moves_[c] = 0;  // empty cluster keeps its center
+      continue;
+    }
+    for (size_t d = 0; d < dims_; ++d)
+      sum[d] /= static_cast<DataType>(count);
+    moves_[c] = std::sqrt(SquaredDistance(centers_[c], sum.data(), dims_));
+    std::copy(sum.begin(), sum.end(), centers_[c]);
+  }
+}
+
+void KMeansSolver::UpdateBounds() {
+  if (algorithm_ == KMeansAlgorithm::Hamerly) {
+    // the lower bound decreases by the largest move of the other centers
+    size_t max_idx = 0;
+    for (size_t c = 1; c < k_; ++c)
+      if (moves_[c] > moves_[max_idx])
+        max_idx = c;
+    DataType second_max = 0;
+    for (size_t c = 0; c < k_; ++c)
+      if (c != max_idx)
+        second_max = std::max(second_max, moves_[c]);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n_; ++i) {
+      auto a = labels_[i];
+      upper_[i] += moves_[a];
+      lower_[i] -= a == max_idx ? second_max : moves_[max_idx];
+    }
+  } else if (algorithm_ == KMeansAlgorithm::Elkan) {
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n_; ++i) {
+      upper_[i] += moves_[labels_[i]];
+      auto* lower = &lower_[i * k_];
+      for (size_t c = 0; c < k_; ++c)
+        lower[c] = std::max<DataType>(0, lower[c] - moves_[c]);
+    }
+  }
+}
+}  // namespace
+
+KMeansResult KMeans(PointsView points,
+                    Points initial_centers,
+                    const KMeansOptions& options) {
+  if (points.rows == 0 || initial_centers.rows == 0)
+    return {};
+  KMeansSolver solver(points, std::move(initial_centers), options.algorithm);
+  return solver.Run(options.max_iterations);
+}
+
+DataType PartitionInertia(PointsView points,
+                          const std::vector<size_t>& labels,
+                          size_t num_clusters) {
+  const auto dims = points.cols;
+  Points means(num_clusters, dims);
+  std::vector<size_t> counts(num_clusters, 0);
+  for (size_t i = 0; i < points.rows; ++i) {
+    for (size_t d = 0; d < dims; ++d)
+      means[labels[i]][d] += points[i][d];
+    ++counts[labels[i]];
+  }
+  for (size_t c = 0; c < num_clusters; ++c)
+    for (size_t d = 0; d < dims && counts[c] > 0; ++d)
+      means[c][d] /= static_cast<DataType>(counts[c]);
+
+  DataType inertia = 0;
+#pragma omp parallel for reduction(+ : inertia) schedule(static)
+  for (size_t i = 0; i < points.rows; ++i)
+    inertia += SquaredDistance(points[i], means[labels[i]], dims);
+  return inertia;
+}
+
+}  // namespace clustering
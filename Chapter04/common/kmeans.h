@@ -0,0 +1,52 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include "points.h"
+
+#include <vector>
+
+namespace clustering {
+
+enum class KMeansAlgorithm {
+  Auto,     // Hamerly for few clusters, Elkan otherwise
+  Lloyd,    // computes all distances, the reference implementation
+  Hamerly,  // one upper and one lower bound per sample
+  Elkan     // one upper and k lower bounds per sample
+};
+
+struct KMeansOptions {
+  KMeansAlgorithm algorithm{KMeansAlgorithm::Auto};
+  size_t max_iterations{300};
+};
+
+struct KMeansResult {
+  Points centers;
+  std::vector<size_t> labels;
+  DataType inertia{0};
+  size_t iterations{0};
+  // sample to center distances computed and avoided compared with Lloyd,
+  // counted per sample, so the sum can exceed the Lloyd count when a bound
+  // check recomputes a distance
+  size_t distances{0};
+  size_t skipped_distances{0};
+  bool converged{false};
+};
+
+// Exact k-means: all algorithms give the same result as Lloyd iterations,
+// the bound based ones use the triangle inequality to skip distance
+// computations which can not change the assignment. Samples are processed
+// in parallel blocks, every block accumulates its own center sums which are
+// merged in the block order, so results do not depend on the threads number.
+KMeansResult KMeans(PointsView points,
+                    Points initial_centers,
+                    const KMeansOptions& options = {});
+
+// Sum of squared distances from samples to the means of their clusters, for
+// clustering algorithms which do not expose centers
+DataType PartitionInertia(PointsView points,
+                          const std::vector<size_t>& labels,
+                          size_t num_clusters);
+
+}  // namespace clustering
+
+#endif  // KMEANS_H
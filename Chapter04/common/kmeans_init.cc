@@ -0,0 +1,191 @@
+#include "kmeans_init.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace clustering {
+
+namespace {
+const size_t kBlockSize = 1024;
+// candidate weights are merged from that many sample ranges
+const size_t kPartitions = 64;
+
+// Uniform [0, 1) value which depends only on the seed, round and sample
+DataType UniformValue(unsigned seed, size_t round, size_t i) {
+  // splitmix64 finalizer
+  uint64_t x = (uint64_t(seed) << 32) ^ (uint64_t(round) << 48) ^ i;
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x = x ^ (x >> 31);
+  return static_cast<DataType>(x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Index sampled with probabilities proportional to the weights
+size_t SampleIndex(const std::vector<DataType>& weights,
+                   std::mt19937& rand_engine) {
+  std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+  return dist(rand_engine);
+}
+
+// Weighted greedy k-means++ followed by weighted Lloyd iterations on the
+// candidates
+Points ReduceCandidates(const Points& candidates,
+                        const std::vector<DataType>& weights,
+                        size_t k,
+                        size_t iterations,
+                        std::mt19937& rand_engine) {
+  const auto m = candidates.rows;
+  const auto dims = candidates.cols;
+  Points centers(k, dims);
+  std::copy_n(candidates[SampleIndex(weights, rand_engine)], dims,
+              centers[0]);
+  std::vector<DataType> min_dist(m);
+  for (size_t j = 0; j < m; ++j)
+    min_dist[j] = SquaredDistance(candidates[j], centers[0], dims);
+  // greedy k-means++: several trials per step, the one giving the lowest
+  // potential wins
+  const auto trials = 2 + static_cast<size_t>(std::log(k));
+  std::vector<DataType> probs(m);
+  std::vector<DataType> trial_dist(m);
+  for (size_t c = 1; c < k; ++c) {
+    for (size_t j = 0; j < m; ++j)
+      probs[j] = weights[j] * min_dist[j];
+    bool all_covered = std::none_of(probs.begin(), probs.end(),
+                                    [](DataType p) { return p > 0; });
+    size_t best = 0;
+    auto best_potential = std::numeric_limits<DataType>::max();
+    for (size_t t = 0; t < trials; ++t) {
+      auto next = SampleIndex(all_covered ? weights : probs, rand_engine);
+      DataType potential = 0;
+      for (size_t j = 0; j < m; ++j) {
+        trial_dist[j] = std::min(
+            min_dist[j], SquaredDistance(candidates[j], candidates[next], dims));
+        potential += weights[j] * trial_dist[j];
+      }
+      if (potential < best_potential) {
+        best_potential = potential;
+        best = next;
+      }
+    }
+    std::copy_n(candidates[best], dims, centers[c]);
+    for (size_t j = 0; j < m; ++j)
+      min_dist[j] = std::min(
+          min_dist[j], SquaredDistance(candidates[j], centers[c], dims));
+  }
+
+  std::vector<size_t> labels(m);
+  for (size_t iteration = 0; iteration < iterations; ++iteration) {
+    for (size_t j = 0; j < m; ++j)
+      labels[j] = NearestCenter(candidates[j], centers);
+    std::vector<DataType> sums(k * dims, 0);
+    std::vector<DataType> total_weights(k, 0);
+    for (size_t j = 0; j < m; ++j) {
+      for (size_t d = 0; d < dims; ++d)
+        sums[labels[j] * dims + d] += weights[j] * candidates[j][d];
+      total_weights[labels[j]] += weights[j];
+    }
+    for (size_t c = 0; c < k; ++c) {
+      if (total_weights[c] > 0) {
+        for (size_t d = 0; d < dims; ++d)
+          centers[c][d] = sums[c * dims + d] / total_weights[c];
+      }
+    }
+  }
+  return centers;
+}
+}  // namespace
+
+Points KMeansParallelInit(PointsView points,
+                          size_t k,
+                          const KMeansParallelOptions& options) {
+  const auto n = points.rows;
+  const auto dims = points.cols;
+  if (n == 0 || k == 0)
+    return Points(0, dims);
+  const auto oversampling = options.oversampling > 0
+                                ? options.oversampling
+                                : static_cast<DataType>(2 * k);
+  const auto blocks_num = (n + kBlockSize - 1) / kBlockSize;
+  std::mt19937 rand_engine(options.seed);
+
+  std::vector<size_t> candidate_ids{
+      std::uniform_int_distribution<size_t>(0, n - 1)(rand_engine)};
+  std::vector<DataType> min_dist(n);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    min_dist[i] = SquaredDistance(points[i], points[candidate_ids[0]], dims);
+
+  for (size_t round = 0; round < options.rounds; ++round) {
+    DataType cost = 0;
+#pragma omp parallel for reduction(+ : cost) schedule(static)
+    for (size_t i = 0; i < n; ++i)
+      cost += min_dist[i];
+    if (cost <= 0)
+      break;
+
+    // independent sampling of every sample with l * d^2 / cost probability
+    std::vector<std::vector<size_t>> block_picks(blocks_num);
+#pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < blocks_num; ++b) {
+      auto end = std::min(n, (b + 1) * kBlockSize);
+      for (auto i = b * kBlockSize; i < end; ++i) {
+        if (UniformValue(options.seed, round + 1, i) <
+            oversampling * min_dist[i] / cost)
+          block_picks[b].push_back(i);
+      }
+    }
+    std::vector<size_t> picks;
+    for (auto& block : block_picks)
+      picks.insert(picks.end(), block.begin(), block.end());
+    candidate_ids.insert(candidate_ids.end(), picks.begin(), picks.end());
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; ++i) {
+      for (auto id : picks)
+        min_dist[i] =
+            std::min(min_dist[i], SquaredDistance(points[i], points[id], dims));
+    }
+  }
+
+  Points candidates(candidate_ids.size(), dims);
+  for (size_t j = 0; j < candidates.rows; ++j)
+    std::copy_n(points[candidate_ids[j]], dims, candidates[j]);
+
+  // candidate weight is the number of samples closest to it
+  const auto partitions_num =
+      std::max<size_t>(1, std::min(kPartitions, blocks_num));
+  std::vector<std::vector<DataType>> partition_weights(
+      partitions_num, std::vector<DataType>(candidates.rows, 0));
+#pragma omp parallel for schedule(dynamic)
+  for (size_t p = 0; p < partitions_num; ++p) {
+    auto begin = p * blocks_num / partitions_num * kBlockSize;
+    auto end = std::min(n, (p + 1) * blocks_num / partitions_num * kBlockSize);
+    auto& weights = partition_weights[p];
+    for (auto i = begin; i < end; ++i)
+      weights[NearestCenter(points[i], candidates)] += 1;
+  }
+  auto& weights = partition_weights[0];
+  for (size_t p = 1; p < partitions_num; ++p)
+    for (size_t j = 0; j < weights.size(); ++j)
+      weights[j] += partition_weights[p][j];
+
+  if (candidates.rows <= k) {
+    // not enough candidates, e.g. for duplicated samples; add random ones
+    Points centers(k, dims);
+    std::copy(candidates.values.begin(), candidates.values.end(),
+              centers.values.begin());
+    std::uniform_int_distribution<size_t> dist(0, n - 1);
+    for (auto c = candidates.rows; c < k; ++c)
+      std::copy_n(points[dist(rand_engine)], dims, centers[c]);
+    return centers;
+  }
+  return ReduceCandidates(candidates, weights, k,
+                          options.recluster_iterations, rand_engine);
+}
+
+}  // namespace clustering
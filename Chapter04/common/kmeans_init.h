@@ -0,0 +1,27 @@
+#ifndef KMEANS_INIT_H
+#define KMEANS_INIT_H
+
+#include "points.h"
+
+namespace clustering {
+
+struct KMeansParallelOptions {
+  size_t rounds{5};
+  DataType oversampling{0};  // expected candidates per round, 0 means 2 * k
+  size_t recluster_iterations{10};
+  unsigned seed{0};
+};
+
+// k-means|| seeding (Bahmani et al., 2012). Every round samples candidates
+// in parallel with probabilities proportional to the squared distance to the
+// already chosen ones, then the weighted candidates are reduced to k centers
+// with greedy k-means++ and a few weighted Lloyd iterations. Random numbers
+// are derived from the sample index, so the result does not depend on the
+// threads number.
+Points KMeansParallelInit(PointsView points,
+                          size_t k,
+                          const KMeansParallelOptions& options = {});
+
+}  // namespace clustering
+
+#endif  // KMEANS_INIT_H
@@ -0,0 +1,186 @@
+#include "minibatch_kmeans.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace clustering {
+
+MiniBatchKMeans::MiniBatchKMeans(size_t num_clusters,
+                                 const MiniBatchKMeansOptions& options)
+    : num_clusters_(num_clusters),
+      options_(options),
+      rand_engine_(options.seed) {}
+
+void MiniBatchKMeans::SetCenters(Points centers) {
+  centers_ = std::move(centers);
+  counts_.assign(centers_.rows, 0);
+}
+
+DataType MiniBatchKMeans::PartialFit(PointsView batch) {
+  const auto dims = batch.cols;
+  if (centers_.rows < num_clusters_) {
+    // random distinct samples of the batch, batches smaller than the number
+    // of clusters are all taken and the next ones add the remaining centers
+    std::vector<size_t> indices(batch.rows);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::shuffle(indices.begin(), indices.end(), rand_engine_);
+    auto first = centers_.rows;
+    auto added = std::min(num_clusters_ - first, batch.rows);
+    centers_.cols = dims;
+    centers_.rows += added;
+    centers_.values.resize(centers_.rows * dims);
+    for (size_t c = 0; c < added; ++c)
+      std::copy_n(batch[indices[c]], dims, centers_[first + c]);
+    counts_.resize(centers_.rows, 0);
+  }
+
+  // assignment step, every thread accumulates its own sums
+  const auto k = centers_.rows;
+  std::vector<std::vector<DataType>> thread_sums;
+  std::vector<std::vector<size_t>> thread_counts;
+  DataType inertia = 0;
+#pragma omp parallel reduction(+ : inertia)
+  {
+#pragma omp single
+    {
+      thread_sums.resize(static_cast<size_t>(omp_get_num_threads()));
+      thread_counts.resize(thread_sums.size());
+    }
+    auto t = static_cast<size_t>(omp_get_thread_num());
+    auto& sums = thread_sums[t];
+    auto& counts = thread_counts[t];
+    sums.assign(k * dims, 0);
+    counts.assign(k, 0);
+#pragma omp for schedule(static)
+    for (size_t i = 0; i < batch.rows; ++i) {
+      DataType dist = 0;
+      auto c = NearestCenter(batch[i], centers_, &dist);
+      inertia += dist;
+      ++counts[c];
+      for (size_t d = 0; d < dims; ++d)
+        sums[c * dims + d] += batch[i][d];
+    }
+  }
+
+  // merge in the thread order so results are reproducible
+  std::vector<DataType> sums(k * dims, 0);
+  std::vector<size_t> counts(k, 0);
+  for (size_t t = 0; t < thread_sums.size(); ++t) {
+    for (size_t j = 0; j < sums.size(); ++j)
+      sums[j] += thread_sums[t][j];
+    for (size_t c = 0; c < k; ++c)
+      counts[c] += thread_counts[t][c];
+  }
+
+  // per-center learning rate: the new center is the running mean of all
+  // samples ever assigned to it
+  DataType shift = 0;
+  for (size_t c = 0; c < k; ++c) {
+    if (counts[c] == 0)
+      continue;
+    counts_[c] += counts[c];
+    auto eta = DataType(1) / static_cast<DataType>(counts_[c]);
+    for (size_t d = 0; d < dims; ++d) {
+      auto& center = centers_[c][d];
+      auto delta =
+          eta * (sums[c * dims + d] - static_cast<DataType>(counts[c]) * center);
+      center += delta;
+      shift += delta * delta;
+    }
+  }
+  monitor_.centers_shift = shift;
+  return inertia;
+}
+
+bool MiniBatchKMeans::UpdateMonitor(DataType batch_inertia,
+                                    size_t batch_size,
+                                    size_t num_samples) {
+  auto inertia = batch_inertia / static_cast<DataType>(batch_size);
+  ++monitor_.iterations;
+  if (monitor_.iterations == 1) {
+    monitor_.ewa_inertia = inertia;
+    monitor_.best_inertia = inertia;
+    return false;
+  }
+  // smoothing over about half an epoch, a fixed window for streams
+  DataType alpha =
+      num_samples > 0
+          ? std::min<DataType>(1, 2. * batch_size / (num_samples + 1))
+          : DataType(0.1);
+  monitor_.ewa_inertia = monitor_.ewa_inertia * (1 - alpha) + inertia * alpha;
+
+  if (monitor_.ewa_inertia < monitor_.best_inertia) {
+    monitor_.best_inertia = monitor_.ewa_inertia;
+    monitor_.no_improvement = 0;
+  } else {
+    ++monitor_.no_improvement;
+  }
+  monitor_.converged =
+      monitor_.no_improvement >= options_.max_no_improvement ||
+      monitor_.centers_shift / static_cast<DataType>(centers_.values.size()) <
+          options_.tolerance;
+  return monitor_.converged || monitor_.iterations >= options_.max_iterations;
+}
+
+void MiniBatchKMeans::Fit(PointsView points) {
+  const auto batch_size = std::min(options_.batch_size, points.rows);
+  if (batch_size == 0)
+    return;
+  if (centers_.rows == 0) {
+    // distinct random samples (Floyd's algorithm), batches are drawn with
+    // replacement and could give the same sample twice
+    const auto k = std::min(num_clusters_, points.rows);
+    std::vector<size_t> indices;
+    indices.reserve(k);
+    for (auto j = points.rows - k; j < points.rows; ++j) {
+      auto index = std::uniform_int_distribution<size_t>(0, j)(rand_engine_);
+      if (std::find(indices.begin(), indices.end(), index) != indices.end())
+        index = j;
+      indices.push_back(index);
+    }
+    Points centers(k, points.cols);
+    for (size_t c = 0; c < k; ++c)
+      std::copy_n(points[indices[c]], points.cols, centers[c]);
+    SetCenters(std::move(centers));
+  }
+  std::uniform_int_distribution<size_t> dist(0, points.rows - 1);
+  Points batch(batch_size, points.cols);
+  do {
+    for (size_t i = 0; i < batch_size; ++i)
+      std::copy_n(points[dist(rand_engine_)], points.cols, batch[i]);
+  } while (!UpdateMonitor(PartialFit(batch.View()), batch_size, points.rows));
+}
+
+void MiniBatchKMeans::Fit(CsvChunkReader& reader, size_t epochs) {
+  Points batch;
+  for (size_t epoch = 0; epoch < epochs; ++epoch) {
+    reader.Rewind();
+    while (reader.ReadChunk(batch, options_.batch_size)) {
+      if (UpdateMonitor(PartialFit(batch.View()), batch.rows, 0))
+        return;
+    }
+  }
+}
+
+std::vector<size_t> MiniBatchKMeans::Predict(PointsView points) const {
+  std::vector<size_t> labels(points.rows);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < points.rows; ++i)
+    labels[i] = NearestCenter(points[i], centers_);
+  return labels;
+}
+
+DataType MiniBatchKMeans::Inertia(PointsView points) const {
+  DataType inertia = 0;
+#pragma omp parallel for reduction(+ : inertia) schedule(static)
+  for (size_t i = 0; i < points.rows; ++i) {
+    DataType dist = 0;
+    NearestCenter(points[i], centers_, &dist);
+    inertia += dist;
+  }
+  return inertia;
+}
+
+}  // namespace clustering
@@ -0,0 +1,79 @@
+#ifndef MINIBATCH_KMEANS_H
+#define MINIBATCH_KMEANS_H
+
+#include "csv_chunks.h"
+#include "points.h"
+
+#include <random>
+#include <vector>
+
+namespace clustering {
+
+struct MiniBatchKMeansOptions {
+  size_t batch_size{1024};
+  size_t max_iterations{1000};  // mini-batches
+  // stop when the smoothed inertia did not improve for that many batches
+  size_t max_no_improvement{10};
+  // stop when the squared centers shift per feature is below that value
+  DataType tolerance{1e-7};
+  unsigned seed{0};
+};
+
+// Tracks the exponentially weighted average of the mini-batch inertia
+struct ConvergenceMonitor {
+  size_t iterations{0};
+  DataType ewa_inertia{0};
+  DataType best_inertia{0};
+  size_t no_improvement{0};
+  DataType centers_shift{0};
+  bool converged{false};
+};
+
+// Mini-batch k-means (Sculley, 2010). Every center is moved towards the mean
+// of its samples in the batch with the learning rate 1 / (samples assigned to
+// the center so far). The assignment step runs in parallel with per-thread
+// center accumulators.
+class MiniBatchKMeans {
+ public:
+  explicit MiniBatchKMeans(size_t num_clusters,
+                           const MiniBatchKMeansOptions& options = {});
+
+  // Initial centers, otherwise random samples of the first batches are used
+  // until there are num_clusters of them
+  void SetCenters(Points centers);
+
+  // One update step on the batch, returns the batch inertia. The convergence
+  // monitor is updated by the Fit methods only.
+  DataType PartialFit(PointsView batch);
+
+  // Updates the centers with random mini-batches of in-memory samples until
+  // the convergence monitor stops the training. Without initial centers
+  // distinct random samples of all points are used.
+  void Fit(PointsView points);
+
+  // Streams the file in batches, at most epochs passes over it
+  void Fit(CsvChunkReader& reader, size_t epochs);
+
+  std::vector<size_t> Predict(PointsView points) const;
+  DataType Inertia(PointsView points) const;
+
+  const Points& GetCenters() const { return centers_; }
+  const ConvergenceMonitor& GetMonitor() const { return monitor_; }
+
+ private:
+  // Returns true if the training should stop
+  bool UpdateMonitor(DataType batch_inertia,
+                     size_t batch_size,
+                     size_t num_samples);
+
+  size_t num_clusters_;
+  MiniBatchKMeansOptions options_;
+  Points centers_;
+  std::vector<size_t> counts_;
+  ConvergenceMonitor monitor_;
+  std::mt19937 rand_engine_;
+};
+
+}  // namespace clustering
+
+#endif  // MINIBATCH_KMEANS_H
@@ -0,0 +1,70 @@
+#ifndef POINTS_H
+#define POINTS_H
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace clustering {
+
+using DataType = double;
+
+// Non-owning view of a row-major samples matrix
+struct PointsView {
+  const DataType* data{nullptr};
+  size_t rows{0};
+  size_t cols{0};
+
+  const DataType* operator[](size_t i) const { return data + i * cols; }
+};
+
+// Row-major samples matrix, one sample per row
+struct Points {
+  Points() = default;
+  Points(size_t rows, size_t cols)
+      : values(rows * cols), rows(rows), cols(cols) {}
+
+  DataType* operator[](size_t i) { return values.data() + i * cols; }
+  const DataType* operator[](size_t i) const {
+    return values.data() + i * cols;
+  }
+  PointsView View() const { return {values.data(), rows, cols}; }
+
+  std::vector<DataType> values;
+  size_t rows{0};
+  size_t cols{0};
+};
+
+inline DataType SquaredDistance(const DataType* a,
+                                const DataType* b,
+                                size_t n) {
+  DataType sum = 0;
+#pragma omp simd reduction(+ : sum)
+  for (size_t i = 0; i < n; ++i) {
+    auto d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+// Index of the center nearest to the sample, centers are rows of the matrix
+inline size_t NearestCenter(const DataType* sample,
+                            const Points& centers,
+                            DataType* dist_sq = nullptr) {
+  size_t nearest = 0;
+  DataType min_dist = std::numeric_limits<DataType>::max();
+  for (size_t c = 0; c < centers.rows; ++c) {
+    auto dist = SquaredDistance(sample, centers[c], centers.cols);
+    if (dist < min_dist) {
+      min_dist = dist;
+      nearest = c;
+    }
+  }
+  if (dist_sq)
+    *dist_sq = min_dist;
+  return nearest;
+}
+
+}  // namespace clustering
+
+#endif  // POINTS_H
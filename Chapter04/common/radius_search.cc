@@ -0,0 +1,159 @@
+#include "radius_search.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace clustering {
+
+namespace {
+// grids with more cells than that are mostly empty, the tree is cheaper
+const int64_t kMaxGridCells = int64_t(1) << 40;
+}  // namespace
+
+RadiusIndex::RadiusIndex(PointsView points, DataType radius)
+    : points_(points), radius_(radius), radius_sq_(radius * radius) {
+  if (points_.cols <= kMaxGridDims && points_.rows > 0)
+    use_grid_ = BuildGrid();
+  if (!use_grid_)
+    tree_ = std::make_unique<KDTree>(points_);
+}
+
+bool RadiusIndex::BuildGrid() {
+  const auto dims = points_.cols;
+  min_coords_.assign(dims, std::numeric_limits<DataType>::max());
+  std::vector<DataType> max_coords(dims,
+                                   std::numeric_limits<DataType>::lowest());
+  for (size_t i = 0; i < points_.rows; ++i) {
+    for (size_t d = 0; d < dims; ++d) {
+      min_coords_[d] = std::min(min_coords_[d], points_[i][d]);
+      max_coords[d] = std::max(max_coords[d], points_[i][d]);
+    }
+  }
+
+  cells_num_.resize(dims);
+  int64_t total_cells = 1;
+  for (size_t d = 0; d < dims; ++d) {
+    auto extent = std::floor((max_coords[d] - min_coords_[d]) / radius_);
+    if (!std::isfinite(extent) ||
+        extent >= static_cast<DataType>(kMaxGridCells))
+      return false;
+    cells_num_[d] = static_cast<int64_t>(extent) + 1;
+    if (total_cells > kMaxGridCells / cells_num_[d])
+      return false;
+    total_cells *= cells_num_[d];
+  }
+
+  cells_.resize(points_.rows * dims);
+  std::vector<int64_t> cell_ids(points_.rows);
+#pragma omp parallel for
+  for (size_t i = 0; i < points_.rows; ++i) {
+    int64_t id = 0;
+    for (size_t d = 0; d < dims; ++d) {
+      auto c = static_cast<int64_t>((points_[i][d] - min_coords_[d]) / radius_);
+      c = std::min(c, cells_num_[d] - 1);
+      cells_[i * dims + d] = c;
+      id = id * cells_num_[d] + c;
+    }
+    cell_ids[i] = id;
+  }
+
+  order_.resize(points_.rows);
+  std::iota(order_.begin(), order_.end(), 0);
+  std::sort(order_.begin(), order_.end(), [&](size_t a, size_t b) {
+    return cell_ids[a] < cell_ids[b] || (cell_ids[a] == cell_ids[b] && a < b);
+  });
+  for (size_t b = 0; b < order_.size();) {
+    auto id = cell_ids[order_[b]];
+    auto e = b + 1;
+    while (e < order_.size() && cell_ids[order_[e]] == id)
+      ++e;
+    cell_ranges_[id] = {b, e};
+    b = e;
+  }
+  return true;
+}
+
+template <typename F>
+void RadiusIndex::ForEachInRadius(size_t i, F&& f) const {
+  if (use_grid_)
+    ForEachInGrid(i, f);
+  else
+    tree_->ForEachInRadius(i, radius_, f);
+}
+
+template <typename F>
+void RadiusIndex::ForEachInGrid(size_t i, F&& f) const {
+  const auto dims = points_.cols;
+  const auto* cell = &cells_[i * dims];
+  // walk over 3^dims adjacent cells
+  int64_t offsets_num = 1;
+  for (size_t d = 0; d < dims; ++d)
+    offsets_num *= 3;
+  for (int64_t offset = 0; offset < offsets_num; ++offset) {
+    int64_t id = 0;
+    auto rest = offset;
+    bool inside = true;
+    for (size_t d = 0; d < dims; ++d) {
+      auto c = cell[d] + (rest % 3) - 1;
+      rest /= 3;
+      if (c < 0 || c >= cells_num_[d]) {
+        inside = false;
+        break;
+      }
+      id = id * cells_num_[d] + c;
+    }
+    if (!inside)
+      continue;
+    auto range = cell_ranges_.find(id);
+    if (range == cell_ranges_.end())
+      continue;
+    for (auto k = range->second.first; k != range->second.second; ++k) {
+      auto j = order_[k];
+      if (j == i)
+        continue;
+      auto dist_sq = SquaredDistance(points_[i], points_[j], dims);
+      if (dist_sq < radius_sq_)
+        f(j, dist_sq);
+    }
+  }
+}
+
+void RadiusIndex::Query(size_t i, std::vector<size_t>& neighbors) const {
+  neighbors.clear();
+  ForEachInRadius(i, [&](size_t j, DataType) { neighbors.push_back(j); });
+}
+
+std::vector<NeighborPair> RadiusIndex::Pairs() const {
+  std::vector<std::vector<NeighborPair>> thread_pairs;
+#pragma omp parallel
+  {
+#pragma omp single
+    thread_pairs.resize(static_cast<size_t>(omp_get_num_threads()));
+
+    // static schedule gives each thread a contiguous ascending block of
+    // samples, so concatenating in thread order keeps pairs sorted
+    auto& pairs = thread_pairs[static_cast<size_t>(omp_get_thread_num())];
+#pragma omp for schedule(static)
+    for (size_t i = 0; i < points_.rows; ++i) {
+      ForEachInRadius(i, [&](size_t j, DataType dist_sq) {
+        if (j > i)
+          pairs.push_back({i, j, std::sqrt(dist_sq)});
+      });
+    }
+  }
+
+  size_t total = 0;
+  for (auto& pairs : thread_pairs)
+    total += pairs.size();
+  std::vector<NeighborPair> result;
+  result.reserve(total);
+  for (auto& pairs : thread_pairs)
+    result.insert(result.end(), pairs.begin(), pairs.end());
+  return result;
+}
+
+}  // namespace clustering
@@ -0,0 +1,68 @@
+#ifndef RADIUS_SEARCH_H
+#define RADIUS_SEARCH_H
+
+#include "kdtree.h"
+#include "points.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace clustering {
+
+// Edge between two samples, index1 is always less than index2
+struct NeighborPair {
+  size_t index1{0};
+  size_t index2{0};
+  DataType distance{0};
+};
+
+// Spatial index answering "all samples closer than radius" queries.
+// Data with up to kMaxGridDims features is bucketed into a uniform grid with
+// the cell size equal to the radius, so only adjacent cells are scanned.
+// Higher dimensional data (or data too sparse for a grid) uses a KD-tree.
+class RadiusIndex {
+ public:
+  static constexpr size_t kMaxGridDims = 3;
+
+  RadiusIndex(PointsView points, DataType radius);
+
+  // Indices of all samples (except i itself) closer than radius to sample i
+  void Query(size_t i, std::vector<size_t>& neighbors) const;
+
+  // All pairs closer than radius, each pair is reported once. Pairs are
+  // gathered in parallel and returned ordered by index1.
+  std::vector<NeighborPair> Pairs() const;
+
+  bool UsesGrid() const { return use_grid_; }
+  PointsView GetPoints() const { return points_; }
+  DataType GetRadius() const { return radius_; }
+
+ private:
+  bool BuildGrid();
+
+  template <typename F>
+  void ForEachInRadius(size_t i, F&& f) const;
+  template <typename F>
+  void ForEachInGrid(size_t i, F&& f) const;
+
+  PointsView points_;
+  DataType radius_;
+  DataType radius_sq_;
+  bool use_grid_{false};
+
+  // grid state
+  std::vector<size_t> order_;  // sample indices sorted by grid cell
+  std::vector<DataType> min_coords_;
+  std::vector<int64_t> cells_num_;
+  std::vector<int64_t> cells_;  // cell coordinates per sample
+  std::unordered_map<int64_t, std::pair<size_t, size_t>> cell_ranges_;
+
+  std::unique_ptr<KDTree> tree_;
+};
+
+}  // namespace clustering
+
+#endif  // RADIUS_SEARCH_H
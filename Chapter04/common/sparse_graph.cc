@@ -0,0 +1,106 @@
+#include "sparse_graph.h"
+#include "kdtree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace clustering {
+
+void SparseMatrix::Multiply(const DataType* x, DataType* y) const {
+  const auto n = Size();
+#pragma omp parallel for schedule(static)
+  for (size_t r = 0; r < n; ++r) {
+    DataType sum = 0;
+    for (auto k = row_offsets[r]; k != row_offsets[r + 1]; ++k)
+      sum += values[k] * x[columns[k]];
+    y[r] = sum;
+  }
+}
+
+SparseMatrix MakeKnnAffinity(PointsView points, size_t k) {
+  const auto n = points.rows;
+  KDTree tree(points);
+
+  std::vector<std::vector<size_t>> knn(n);
+#pragma omp parallel
+  {
+    std::vector<Neighbor> neighbors;
+#pragma omp for schedule(static)
+    for (size_t i = 0; i < n; ++i) {
+      tree.KNearest(i, k, neighbors);
+      knn[i].reserve(neighbors.size());
+      for (auto& neighbor : neighbors)
+        knn[i].push_back(neighbor.second);
+    }
+  }
+
+  // symmetrize: row i gets its own neighbors plus samples having i as
+  // a neighbor
+  std::vector<size_t> degrees(n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    degrees[i] += knn[i].size();
+    for (auto j : knn[i])
+      ++degrees[j];
+  }
+  SparseMatrix affinity;
+  affinity.row_offsets.resize(n + 1, 0);
+  for (size_t i = 0; i < n; ++i)
+    affinity.row_offsets[i + 1] = affinity.row_offsets[i] + degrees[i];
+  affinity.columns.resize(affinity.row_offsets[n]);
+  std::vector<size_t> fill(affinity.row_offsets.begin(),
+                           affinity.row_offsets.end() - 1);
+  for (size_t i = 0; i < n; ++i) {
+    for (auto j : knn[i]) {
+      affinity.columns[fill[i]++] = j;
+      affinity.columns[fill[j]++] = i;
+    }
+  }
+
+  // remove mutual neighbors duplicates and compact rows
+  std::vector<size_t> unique_sizes(n);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i) {
+    auto begin = affinity.columns.begin() + affinity.row_offsets[i];
+    auto end = affinity.columns.begin() + affinity.row_offsets[i + 1];
+    std::sort(begin, end);
+    unique_sizes[i] = std::distance(begin, std::unique(begin, end));
+  }
+  size_t offset = 0;
+  for (size_t i = 0; i < n; ++i) {
+    auto begin = affinity.row_offsets[i];
+    std::copy(affinity.columns.begin() + begin,
+              affinity.columns.begin() + begin + unique_sizes[i],
+              affinity.columns.begin() + offset);
+    affinity.row_offsets[i] = offset;
+    offset += unique_sizes[i];
+  }
+  affinity.row_offsets[n] = offset;
+  affinity.columns.resize(offset);
+  affinity.values.assign(offset, 1);
+  return affinity;
+}
+
+SparseMatrix NormalizeAffinity(const SparseMatrix& affinity) {
+  const auto n = affinity.Size();
+  std::vector<DataType> inv_sqrt_degree(n);
+#pragma omp parallel for schedule(static)
+  for (size_t r = 0; r < n; ++r) {
+    DataType degree = 0;
+    for (auto k = affinity.row_offsets[r]; k != affinity.row_offsets[r + 1];
+         ++k)
+      degree += affinity.values[k];
+    inv_sqrt_degree[r] = degree > 0 ? 1 / std::sqrt(degree) : 0;
+  }
+
+  SparseMatrix normalized = affinity;
+#pragma omp parallel for schedule(static)
+  for (size_t r = 0; r < n; ++r) {
+    for (auto k = affinity.row_offsets[r]; k != affinity.row_offsets[r + 1];
+         ++k)
+      normalized.values[k] *=
+          inv_sqrt_degree[r] * inv_sqrt_degree[affinity.columns[k]];
+  }
+  return normalized;
+}
+
+}  // namespace clustering
@@ -0,0 +1,35 @@
+#ifndef SPARSE_GRAPH_H
+#define SPARSE_GRAPH_H
+
+#include "points.h"
+
+#include <vector>
+
+namespace clustering {
+
+// Square sparse matrix in the compressed sparse rows layout, used for
+// graph adjacency (affinity) matrices indexed by sample index
+struct SparseMatrix {
+  size_t Size() const {
+    return row_offsets.empty() ? 0 : row_offsets.size() - 1;
+  }
+  size_t NonZeros() const { return values.size(); }
+
+  // y = M * x, rows are processed in parallel
+  void Multiply(const DataType* x, DataType* y) const;
+
+  std::vector<size_t> row_offsets;  // Size() + 1 elements
+  std::vector<size_t> columns;
+  std::vector<DataType> values;
+};
+
+// Symmetric kNN affinity graph: samples i and j are connected with weight 1
+// if one of them is among the k nearest neighbors of the other one
+SparseMatrix MakeKnnAffinity(PointsView points, size_t k);
+
+// D^-1/2 * W * D^-1/2 where D is the diagonal matrix of W row sums
+SparseMatrix NormalizeAffinity(const SparseMatrix& affinity);
+
+}  // namespace clustering
+
+#endif  // SPARSE_GRAPH_H
@@ -0,0 +1,318 @@
+#include "spectral.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace clustering {
+
+namespace {
+// problems of that size are solved with the dense eigen solver
+const size_t kMaxDenseSize = 200;
+
+DataType ColumnNorm(const Points& basis, size_t p) {
+  DataType sum = 0;
+#pragma omp parallel for reduction(+ : sum) schedule(static)
+  for (size_t r = 0; r < basis.rows; ++r)
+    sum += basis[r][p] * basis[r][p];
+  return std::sqrt(sum);
+}
+
+// Orthogonalizes basis column p against columns [0, p) with classical
+// Gram-Schmidt, a second pass is done only if the column lost most of its
+// norm (DGKS criterion). The projections are added to coeffs (may be
+// nullptr). Returns the norm of the orthogonal part, the column is normalized.
+// The basis is row-major so every pass streams the basis memory once.
+DataType Orthonormalize(Points& basis, size_t p, DataType* coeffs) {
+  const auto n = basis.rows;
+  auto norm = ColumnNorm(basis, p);
+  std::vector<DataType> proj(p);
+  auto* proj_data = proj.data();
+  for (int pass = 0; pass < 2 && p > 0; ++pass) {
+    std::fill(proj.begin(), proj.end(), 0);
+#pragma omp parallel for reduction(+ : proj_data[:p]) schedule(static)
+    for (size_t r = 0; r < n; ++r) {
+      const auto* row = basis[r];
+      auto w = row[p];
+#pragma omp simd
+      for (size_t q = 0; q < p; ++q)
+        proj_data[q] += row[q] * w;
+    }
+#pragma omp parallel for schedule(static)
+    for (size_t r = 0; r < n; ++r) {
+      auto* row = basis[r];
+      DataType sum = 0;
+#pragma omp simd reduction(+ : sum)
+      for (size_t q = 0; q < p; ++q)
+        sum += row[q] * proj_data[q];
+      row[p] -= sum;
+    }
+    if (coeffs) {
+      for (size_t q = 0; q < p; ++q)
+        coeffs[q] += proj[q];
+    }
+    auto new_norm = ColumnNorm(basis, p);
+    bool orthogonal = new_norm > 0.7 * norm;
+    norm = new_norm;
+    if (orthogonal)
+      break;
+  }
+  if (norm > 0) {
+#pragma omp parallel for schedule(static)
+    for (size_t r = 0; r < n; ++r)
+      basis[r][p] /= norm;
+  }
+  return norm;
+}
+
+// Fills basis column p with a random unit vector orthogonal to [0, p)
+void RandomOrthonormal(Points& basis, size_t p, std::mt19937& rand_engine) {
+  std::normal_distribution<DataType> dist;
+  do {
+    for (size_t r = 0; r < basis.rows; ++r)
+      basis[r][p] = dist(rand_engine);
+  } while (Orthonormalize(basis, p, nullptr) < 1e-8);
+}
+
+EigenPairs DenseLargestEigenPairs(const SparseMatrix& matrix, size_t k) {
+  const auto n = matrix.Size();
+  std::vector<DataType> dense(n * n, 0);
+  for (size_t r = 0; r < n; ++r) {
+    for (auto i = matrix.row_offsets[r]; i != matrix.row_offsets[r + 1]; ++i)
+      dense[r * n + matrix.columns[i]] = matrix.values[i];
+  }
+  std::vector<DataType> values;
+  std::vector<DataType> vectors;
+  SymmetricEigen(std::move(dense), n, values, vectors);
+
+  EigenPairs result;
+  result.values.assign(values.begin(), values.begin() + k);
+  result.vectors = Points(n, k);
+  for (size_t r = 0; r < n; ++r)
+    std::copy_n(&vectors[r * n], k, result.vectors[r]);
+  result.converged = true;
+  return result;
+}
+}  // namespace
+
+void SymmetricEigen(std::vector<DataType> a,
+                    size_t n,
+                    std::vector<DataType>& values,
+                    std::vector<DataType>& vectors) {
+  std::vector<DataType> v(n * n, 0);
+  for (size_t i = 0; i < n; ++i)
+    v[i * n + i] = 1;
+
+  const DataType norm =
+      std::sqrt(std::inner_product(a.begin(), a.end(), a.begin(), 0.0));
+  for (int sweep = 0; sweep < 100; ++sweep) {
+    DataType off = 0;
+    for (size_t p = 0; p < n; ++p)
+      for (size_t q = p + 1; q < n; ++q)
+        off += a[p * n + q] * a[p * n + q];
+    if (std::sqrt(off) <= 1e-14 * norm)
+      break;
+
+    for (size_t p = 0; p < n; ++p) {
+      for (size_t q = p + 1; q < n; ++q) {
+        auto apq = a[p * n + q];
+        if (std::abs(apq) <= 1e-300)
+          continue;
+        // rotation which zeroes a(p, q)
+        auto theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+        auto t = (theta >= 0 ? 1 : -1) /
+                 (std::abs(theta) + std::sqrt(theta * theta + 1));
+        auto c = 1 / std::sqrt(t * t + 1);
+        auto s = t * c;
+        for (size_t i = 0; i < n; ++i) {
+          auto aip = a[i * n + p];
+          auto aiq = a[i * n + q];
+          a[i * n + p] = c * aip - s * aiq;
+          a[i * n + q] = s * aip + c * aiq;
+        }
+        for (size_t i = 0; i < n; ++i) {
+          auto api = a[p * n + i];
+          auto aqi = a[q * n + i];
+          a[p * n + i] = c * api - s * aqi;
+          a[q * n + i] = s * api + c * aqi;
+        }
+        for (size_t i = 0; i < n; ++i) {
+          auto vip = v[i * n + p];
+          auto viq = v[i * n + q];
+          v[i * n + p] = c * vip - s * viq;
+          v[i * n + q] = s * vip + c * viq;
+        }
+      }
+    }
+  }
+
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+    return a[x * n + x] > a[y * n + y];
+  });
+  values.resize(n);
+  vectors.resize(n * n);
+  for (size_t j = 0; j < n; ++j) {
+    values[j] = a[order[j] * n + order[j]];
+    for (size_t i = 0; i < n; ++i)
+      vectors[i * n + j] = v[i * n + order[j]];
+  }
+}
+
+EigenPairs LargestEigenPairs(const SparseMatrix& matrix,
+                             size_t k,
+                             const LanczosOptions& options) {
+  const auto n = matrix.Size();
+  k = std::min(k, n);
+  if (n <= kMaxDenseSize)
+    return DenseLargestEigenPairs(matrix, k);
+
+  const auto b = k;  // block size
+  auto max_basis = options.max_basis_size > 0 ? options.max_basis_size
+                                              : std::max<size_t>(15 * k, 45);
+  max_basis = std::min(std::max(max_basis, 4 * b), n);
+  // number of Ritz vectors kept on restart
+  const auto keep = std::max(k, std::min(max_basis / 2, max_basis - 2 * b));
+
+  std::mt19937 rand_engine(options.seed);
+  Points basis(n, max_basis);
+  // H = V^T * A * V, coefficients of the block Arnoldi relation
+  std::vector<DataType> h(max_basis * max_basis, 0);
+  std::vector<DataType> ritz_values;
+  std::vector<DataType> ritz_vectors;
+  std::vector<DataType> x(n);
+  std::vector<DataType> y(n);
+
+  EigenPairs result;
+  for (size_t c = 0; c < b; ++c)
+    RandomOrthonormal(basis, c, rand_engine);
+  size_t m = b;  // basis vectors with known A * V projections after expansion
+  for (size_t restart = 0;; ++restart) {
+    bool converged = false;
+    for (; m + b <= max_basis; m += b) {
+      // expand the basis with A * V of the last block
+      for (size_t c = m - b; c < m; ++c) {
+        auto p = c + b;
+        for (size_t r = 0; r < n; ++r)
+          x[r] = basis[r][c];
+        matrix.Multiply(x.data(), y.data());
+        for (size_t r = 0; r < n; ++r)
+          basis[r][p] = y[r];
+        ++result.products;
+        std::vector<DataType> coeffs(p, 0);
+        auto norm = Orthonormalize(basis, p, coeffs.data());
+        for (size_t q = 0; q < p; ++q)
+          h[q * max_basis + c] = coeffs[q];
+        if (norm < 1e-10) {
+          // invariant subspace found, continue with a new direction
+          RandomOrthonormal(basis, p, rand_engine);
+          norm = 0;
+        }
+        h[p * max_basis + c] = norm;
+      }
+
+      // Rayleigh-Ritz on the first m basis vectors
+      std::vector<DataType> projected(m * m);
+      for (size_t r = 0; r < m; ++r)
+        for (size_t c = 0; c < m; ++c)
+          projected[r * m + c] =
+              (h[r * max_basis + c] + h[c * max_basis + r]) / 2;
+      SymmetricEigen(std::move(projected), m, ritz_values, ritz_vectors);
+
+      // residual norms ||A y - theta y|| come from the next block coefficients
+      converged = true;
+      for (size_t j = 0; j < k && converged; ++j) {
+        DataType residual = 0;
+        for (size_t p = m; p < m + b; ++p) {
+          DataType sum = 0;
+          for (size_t c = m - b; c < m; ++c)
+            sum += h[p * max_basis + c] * ritz_vectors[c * m + j];
+          residual += sum * sum;
+        }
+        converged = std::sqrt(residual) <=
+                    options.tolerance *
+                        std::max<DataType>(1, std::abs(ritz_values[j]));
+      }
+      if (converged || m + 2 * b > max_basis)
+        break;
+    }
+
+    if (converged || restart == options.max_restarts) {
+      // Ritz vectors y = V * s
+      result.values.assign(ritz_values.begin(), ritz_values.begin() + k);
+      result.vectors = Points(n, k);
+#pragma omp parallel for schedule(static)
+      for (size_t r = 0; r < n; ++r) {
+        for (size_t j = 0; j < k; ++j) {
+          DataType sum = 0;
+          for (size_t c = 0; c < m; ++c)
+            sum += basis[r][c] * ritz_vectors[c * m + j];
+          result.vectors[r][j] = sum;
+        }
+      }
+      result.converged = converged;
+      return result;
+    }
+
+    // thick restart: the basis becomes the leading Ritz vectors followed by
+    // the last expansion block, which keeps the Arnoldi relation valid
+    std::vector<DataType> coupling(b * keep);
+    for (size_t t = 0; t < b; ++t) {
+      for (size_t j = 0; j < keep; ++j) {
+        DataType sum = 0;
+        for (size_t c = m - b; c < m; ++c)
+          sum += h[(m + t) * max_basis + c] * ritz_vectors[c * m + j];
+        coupling[t * keep + j] = sum;
+      }
+    }
+#pragma omp parallel
+    {
+      std::vector<DataType> ritz_row(keep);
+#pragma omp for schedule(static)
+      for (size_t r = 0; r < n; ++r) {
+        auto* row = basis[r];
+        for (size_t j = 0; j < keep; ++j) {
+          DataType sum = 0;
+          for (size_t c = 0; c < m; ++c)
+            sum += row[c] * ritz_vectors[c * m + j];
+          ritz_row[j] = sum;
+        }
+        std::copy_n(row + m, b, row + keep);
+        std::copy(ritz_row.begin(), ritz_row.end(), row);
+      }
+    }
+
+    std::fill(h.begin(), h.end(), 0);
+    for (size_t j = 0; j < keep; ++j) {
+      h[j * max_basis + j] = ritz_values[j];
+      for (size_t t = 0; t < b; ++t) {
+        h[(keep + t) * max_basis + j] = coupling[t * keep + j];
+        h[j * max_basis + keep + t] = coupling[t * keep + j];
+      }
+    }
+    m = keep + b;
+  }
+}
+
+Points SpectralEmbedding(PointsView points,
+                         size_t num_neighbors,
+                         size_t num_clusters,
+                         const LanczosOptions& options) {
+  auto affinity = NormalizeAffinity(MakeKnnAffinity(points, num_neighbors));
+  auto eigen_pairs = LargestEigenPairs(affinity, num_clusters, options);
+  auto embedding = std::move(eigen_pairs.vectors);
+#pragma omp parallel for schedule(static)
+  for (size_t r = 0; r < embedding.rows; ++r) {
+    auto* row = embedding[r];
+    auto len = std::sqrt(
+        std::inner_product(row, row + embedding.cols, row, DataType(0)));
+    if (len > 0)
+      std::transform(row, row + embedding.cols, row,
+                     [len](DataType v) { return v / len; });
+  }
+  return embedding;
+}
+
+}  // namespace clustering
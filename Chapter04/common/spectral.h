@@ -0,0 +1,52 @@
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+#include "points.h"
+#include "sparse_graph.h"
+
+#include <vector>
+
+namespace clustering {
+
+struct LanczosOptions {
+  size_t max_basis_size{0};  // 0 means max(15 * k, 45)
+  size_t max_restarts{20};
+  // relative residual norm, rough eigenvectors are enough for clustering
+  DataType tolerance{1e-3};
+  unsigned seed{0};
+};
+
+struct EigenPairs {
+  std::vector<DataType> values;  // in descending order
+  Points vectors;                // one eigenvector per column
+  size_t products{0};            // number of matrix-vector products
+  bool converged{false};
+};
+
+// Eigen decomposition of a dense symmetric n x n row-major matrix with the
+// cyclic Jacobi method, eigenvalues are sorted in descending order.
+// Suitable for small projected matrices only.
+void SymmetricEigen(std::vector<DataType> matrix,
+                    size_t n,
+                    std::vector<DataType>& values,
+                    std::vector<DataType>& vectors);
+
+// k largest eigenvalues and their eigenvectors of a sparse symmetric matrix
+// computed with the explicitly restarted block Lanczos method with full
+// reorthogonalization. The block size is k, so repeated eigenvalues (one per
+// connected component of a graph) are found as well.
+EigenPairs LargestEigenPairs(const SparseMatrix& matrix,
+                             size_t k,
+                             const LanczosOptions& options = {});
+
+// Rows of the num_clusters leading eigenvectors of the normalized kNN
+// affinity matrix, each row is scaled to unit length. Clustering of these
+// rows gives the spectral clustering of the samples.
+Points SpectralEmbedding(PointsView points,
+                         size_t num_neighbors,
+                         size_t num_clusters,
+                         const LanczosOptions& options = {});
+
+}  // namespace clustering
+
+#endif  // SPECTRAL_H
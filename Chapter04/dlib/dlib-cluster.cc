@@ -1,10 +1,18 @@
+#include "../../Chapter02/csv/common/dataset_cache.h"
+#include "../common/cluster_plot.h"
+#include "../common/dbscan.h"
+#include "../common/kmeans.h"
+#include "../common/kmeans_init.h"
+#include "../common/radius_search.h"
+#include "../common/spectral.h"
+
 #include <dlib/clustering.h>
 #include <dlib/matrix.h>
-#include <plot.h>
 
+#include <chrono>
 #include <experimental/filesystem>
 #include <iostream>
-#include <unordered_map>
+#include <set>
 
 using namespace dlib;
 namespace fs = std::experimental::filesystem;
@@ -19,35 +27,43 @@ const std::vector<std::string> colors{"black", "red",    "blue",  "green",
                                       "cyan",  "yellow", "brown", "magenta"};
 
 using DataType = double;
-using Coords = std::vector<DataType>;
-using PointCoords = std::pair<Coords, Coords>;
-using Clusters = std::unordered_map<size_t, PointCoords>;
 
-void PlotClusters(const Clusters& clusters,
+void PlotClusters(clustering::PointsView points,
+                  const std::vector<size_t>& labels,
                   const std::string& name,
                   const std::string& file_name) {
-  plotcpp::Plot plt;
-  plt.SetTerminal("png");
-  plt.SetOutput(file_name);
-  plt.SetTitle(name);
-  plt.SetXLabel("x");
-  plt.SetYLabel("y");
-  plt.SetAutoscale();
-  plt.GnuplotCommand("set grid");
-
-  auto draw_state = plt.StartDraw2D<Coords::const_iterator>();
-  for (auto& cluster : clusters) {
-    std::stringstream params;
-    params << "lc rgb '" << colors[cluster.first] << "' pt 7";
-    plt.AddDrawing(draw_state,
-                   plotcpp::Points(
-                       cluster.second.first.begin(), cluster.second.first.end(),
-                       cluster.second.second.begin(),
-                       std::to_string(cluster.first) + " cls", params.str()));
+  // binned to the image pixels and passed to gnuplot in binary form
+  clustering::DrawClusters(points, labels, colors, name, file_name);
+}
+
+template <typename I>
+clustering::Points ToPoints(const I& inputs) {
+  clustering::Points points(static_cast<size_t>(inputs.nr()),
+                            static_cast<size_t>(inputs.nc()));
+  for (long r = 0; r < inputs.nr(); ++r) {
+    for (long c = 0; c < inputs.nc(); ++c) {
+      points[r][c] = inputs(r, c);
+    }
   }
+  return points;
+}
 
-  plt.EndDraw2D(draw_state);
-  plt.Flush();
+// Builds graph edges between samples closer than radius with a spatial index,
+// every pair is generated once. Self loops are added to get the same graph as
+// the full pairwise distances scan gives.
+std::vector<sample_pair> MakeRadiusEdges(clustering::PointsView points,
+                                         DataType radius) {
+  clustering::RadiusIndex index(points, radius);
+  auto pairs = index.Pairs();
+  std::vector<sample_pair> edges;
+  edges.reserve(pairs.size() + points.rows);
+  for (size_t i = 0; i < points.rows; ++i) {
+    edges.push_back(sample_pair(i, i, 0));
+  }
+  for (auto& pair : pairs) {
+    edges.push_back(sample_pair(pair.index1, pair.index2, pair.distance));
+  }
+  return edges;
 }
 
 template <typename I>
@@ -63,64 +79,38 @@ void DoHierarhicalClustering(const I& inputs,
   }
   std::vector<unsigned long> clusters;
   bottom_up_cluster(dists, clusters, num_clusters);
-  Clusters plot_clusters;
-  for (long i = 0; i != inputs.nr(); i++) {
-    auto cluser_idx = clusters[i];
-    plot_clusters[cluser_idx].first.push_back(inputs(i, 0));
-    plot_clusters[cluser_idx].second.push_back(inputs(i, 1));
-  }
 
-  PlotClusters(plot_clusters, "Agglomerative clustering", name + "-aggl.png");
+  PlotClusters(ToPoints(inputs).View(),
+               std::vector<size_t>(clusters.begin(), clusters.end()),
+               "Agglomerative clustering", name + "-aggl.png");
 }
 
 template <typename I>
 void DoGraphClustering(const I& inputs, const std::string& name) {
   // chinese whispers algorithm
-  std::vector<sample_pair> edges;
-  for (long i = 0; i < inputs.nr(); ++i) {
-    for (long j = 0; j < inputs.nr(); ++j) {
-      auto dist = length(subm(inputs, i, 0, 1, 2) - subm(inputs, j, 0, 1, 2));
-      if (dist < 1)
-        edges.push_back(sample_pair(i, j, dist));
-    }
-  }
+  auto points = ToPoints(inputs);
+  auto edges = MakeRadiusEdges(points.View(), 1);
   std::vector<unsigned long> clusters;
   const auto num_clusters = chinese_whispers(edges, clusters);
   std::cout << "Num clusters detected: " << num_clusters << std::endl;
-  Clusters plot_clusters;
-  for (long i = 0; i != inputs.nr(); i++) {
-    auto cluser_idx = clusters[i];
-    plot_clusters[cluser_idx].first.push_back(inputs(i, 0));
-    plot_clusters[cluser_idx].second.push_back(inputs(i, 1));
-  }
 
-  PlotClusters(plot_clusters, "Graph clustering", name + "-graph.png");
+  PlotClusters(points.View(),
+               std::vector<size_t>(clusters.begin(), clusters.end()),
+               "Graph clustering", name + "-graph.png");
 }
 
 template <typename I>
 void DoGraphNewmanClustering(const I& inputs, const std::string& name) {
-  std::vector<sample_pair> edges;
-  for (long i = 0; i < inputs.nr(); ++i) {
-    for (long j = 0; j < inputs.nr(); ++j) {
-      auto dist = length(subm(inputs, i, 0, 1, 2) - subm(inputs, j, 0, 1, 2));
-      if (dist < 0.5)
-        edges.push_back(sample_pair(i, j, dist));
-    }
-  }
-  remove_duplicate_edges(edges);
+  auto points = ToPoints(inputs);
+  auto edges = MakeRadiusEdges(points.View(), 0.5);
 
   std::vector<unsigned long> clusters;
   const auto num_clusters = newman_cluster(edges, clusters);
   std::cout << "Num clusters detected: " << num_clusters << std::endl;
-  Clusters plot_clusters;
-  for (long i = 0; i != inputs.nr(); i++) {
-    auto cluser_idx = clusters[i];
-    plot_clusters[cluser_idx].first.push_back(inputs(i, 0));
-    plot_clusters[cluser_idx].second.push_back(inputs(i, 1));
-  }
 
-  PlotClusters(plot_clusters, "Graph Newman clustering",
-               name + "-graph-newman.png");
+  PlotClusters(points.View(),
+               std::vector<size_t>(clusters.begin(), clusters.end()),
+               "Graph Newman clustering", name + "-graph-newman.png");
 }
 
 template <typename I>
@@ -138,74 +128,76 @@ void DoKMeansClustering(const I& inputs,
     samples.push_back(dlib::trans(dlib::subm(inputs, i, 0, 1, 2)));
   }
 
-  std::vector<sample_type> initial_centers;
-  pick_initial_centers(num_clusters, initial_centers, samples,
-                       kmeans.get_kernel());
+  // k-means|| seeding instead of the sequential pick_initial_centers
+  auto points = ToPoints(inputs);
+  auto seed_start = std::chrono::steady_clock::now();
+  auto seeds = clustering::KMeansParallelInit(points.View(), num_clusters);
+  std::chrono::duration<double> seed_time =
+      std::chrono::steady_clock::now() - seed_start;
+
+  std::vector<sample_type> initial_centers(num_clusters);
+  for (size_t c = 0; c != num_clusters; c++) {
+    initial_centers[c](0) = seeds[c][0];
+    initial_centers[c](1) = seeds[c][1];
+  }
 
   kmeans.set_number_of_centers(num_clusters);
   kmeans.train(samples, initial_centers);
 
-  std::vector<unsigned long> clusters;
-  Clusters plot_clusters;
-  for (long i = 0; i != inputs.nr(); i++) {
-    auto cluser_idx = kmeans(samples[i]);
-    plot_clusters[cluser_idx].first.push_back(inputs(i, 0));
-    plot_clusters[cluser_idx].second.push_back(inputs(i, 1));
-  }
+  std::vector<size_t> clusters(samples.size());
+  for (size_t i = 0; i != samples.size(); i++)
+    clusters[i] = kmeans(samples[i]);
+  std::cout << name << " k-means|| seeding time " << seed_time.count()
+            << "s, final inertia "
+            << clustering::PartitionInertia(points.View(), clusters,
+                                            num_clusters)
+            << std::endl;
 
-  PlotClusters(plot_clusters, "K-Means", name + "-kmeans.png");
+  PlotClusters(points.View(), clusters, "K-Means", name + "-kmeans.png");
 }
 
-template <typename T>
-struct knn_kernel {
-  knn_kernel(const std::vector<T>& samples, unsigned long k)
-      : samples_(&samples) {
-    find_k_nearest_neighbors(
-        samples, [](const T& a, const T& b) { return dlib::length(a - b); }, k,
-        edges_);
-    std::sort(edges_.begin(), edges_.end(), order_by_index<sample_pair>);
-  }
-  DataType operator()(const T& a, const T& b) const {
-    auto idx1 = std::distance(samples_->begin(),
-                              std::find(samples_->begin(), samples_->end(), a));
-    auto idx2 = std::distance(samples_->begin(),
-                              std::find(samples_->begin(), samples_->end(), b));
-    sample_pair value{idx1, idx2};
-    auto edge = std::lower_bound(edges_.begin(), edges_.end(), value,
-                                 order_by_index<sample_pair>);
-    if (edge != edges_.end() && !order_by_index<sample_pair>(value, *edge))
-      return 1;
-    else
-      return 0;
-  }
-  std::vector<sample_pair> edges_;
-  const std::vector<T>* samples_;
-};
+template <typename I>
+void DoDBSCANClustering(const I& inputs, const std::string& name) {
+  auto points = ToPoints(inputs);
+  clustering::DBSCANOptions options;
+  options.eps = 0.3;
+  options.min_samples = 5;
+  auto result = clustering::DBSCAN(points.View(), options);
+  std::cout << "Num clusters detected: " << result.num_clusters
+            << " noise samples: " << result.num_noise << std::endl;
+  static_assert(clustering::DBSCANResult::kNoise == clustering::kNoiseLabel,
+                "noise samples are drawn as noise");
+  PlotClusters(points.View(), result.labels, "DBSCAN", name + "-dbscan.png");
+}
 
 template <typename I>
 void DoSpectralClustering(const I& inputs,
                           size_t num_clusters,
                           const std::string& name) {
-  typedef matrix<double, 2, 1> sample_type;
-  typedef knn_kernel<sample_type> kernel_type;
-
-  std::vector<sample_type> samples;
-  samples.reserve(inputs.nr());
-  for (long i = 0; i != inputs.nr(); i++) {
-    samples.push_back(dlib::trans(dlib::subm(inputs, i, 0, 1, 2)));
+  // eigenvectors of the sparse kNN affinity graph instead of a dense kernel
+  // matrix, then the same k-means step as dlib::spectral_cluster does
+  auto points = ToPoints(inputs);
+  auto embedding = clustering::SpectralEmbedding(points.View(), 15,
+                                                 num_clusters);
+
+  typedef matrix<double, 0, 1> spec_sample_type;
+  std::vector<spec_sample_type> spec_samples(embedding.rows);
+  for (size_t i = 0; i != embedding.rows; i++) {
+    spec_samples[i].set_size(static_cast<long>(embedding.cols));
+    for (size_t c = 0; c != embedding.cols; c++) {
+      spec_samples[i](static_cast<long>(c)) = embedding[i][c];
+    }
   }
+  std::vector<spec_sample_type> centers;
+  pick_initial_centers(num_clusters, centers, spec_samples);
+  find_clusters_using_kmeans(spec_samples, centers);
 
-  std::vector<unsigned long> clusters =
-      spectral_cluster(kernel_type(samples, 15), samples, num_clusters);
-
-  Clusters plot_clusters;
-  for (long i = 0; i != inputs.nr(); i++) {
-    auto cluser_idx = clusters[i];
-    plot_clusters[cluser_idx].first.push_back(inputs(i, 0));
-    plot_clusters[cluser_idx].second.push_back(inputs(i, 1));
-  }
+  std::vector<size_t> clusters(spec_samples.size());
+  for (size_t i = 0; i != spec_samples.size(); i++)
+    clusters[i] = nearest_center(centers, spec_samples[i]);
 
-  PlotClusters(plot_clusters, "Spectral clustering", name + "-spectral.png");
+  PlotClusters(points.View(), clusters, "Spectral clustering",
+               name + "-spectral.png");
 }
 
 int main(int argc, char** argv) {
@@ -214,9 +206,17 @@ int main(int argc, char** argv) {
     for (auto& dataset : data_names) {
       auto dataset_name = base_dir / dataset;
       if (fs::exists(dataset_name)) {
-        std::ifstream file(dataset_name);
-        matrix<DataType> data;
-        file >> data;
+        // the parsed file is cached next to it, later runs map the cache
+        auto cache = csv::DatasetCache::Open(dataset_name.string());
+        if (!cache || cache->Cols() < 4) {
+          std::cerr << "Failed to read " << dataset_name << std::endl;
+          continue;
+        }
+        if (cache->WriteFailed())
+          std::cerr << "Failed to write the cache of " << dataset_name
+                    << std::endl;
+        auto data = mat(cache->Values(), static_cast<long>(cache->Rows()),
+                        static_cast<long>(cache->Cols()));
 
         auto inputs = dlib::subm(data, 0, 1, data.nr(), 2);
         auto labels = dlib::subm(data, 0, 3, data.nr(), 1);
@@ -231,13 +231,17 @@ int main(int argc, char** argv) {
         std::cout << dataset << "\n"
                   << "Num samples: " << num_samples
                   << " num features: " << num_features
-                  << " num clusters: " << num_clusters << std::endl;
+                  << " num clusters: " << num_clusters << "\n"
+                  << (cache->FromCache() ? "Warm" : "Cold")
+                  << " load time: " << cache->LoadSeconds() << "s"
+                  << std::endl;
 
         // DoHierarhicalClustering(inputs, num_clusters, dataset);
         // DoGraphClustering(inputs, dataset);
         // DoKMeansClustering(inputs, num_clusters, dataset);
         // DoGraphNewmanClustering(inputs, dataset);
         DoSpectralClustering(inputs, num_clusters, dataset);
+        DoDBSCANClustering(inputs, dataset);
       } else {
         std::cerr << "Dataset file " << dataset_name << " missed\n";
       }
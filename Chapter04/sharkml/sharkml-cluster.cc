@@ -1,16 +1,21 @@
-#include <plot.h>
+#include "../../Chapter02/csv/common/dataset_cache.h"
+#include "../common/cluster_plot.h"
+#include "../common/kmeans.h"
+#include "../common/kmeans_init.h"
+#include "../common/minibatch_kmeans.h"
 
 #define SHARK_CV_VERBOSE 1
 #include <shark/Algorithms/KMeans.h>
-#include <shark/Data/Csv.h>
 #include <shark/Data/Dataset.h>
 #include <shark/Models/Clustering/HardClusteringModel.h>
 #include <shark/Models/Clustering/HierarchicalClustering.h>
 #include <shark/Models/Trees/LCTree.h>
 
+#include <algorithm>
+#include <chrono>
 #include <experimental/filesystem>
 #include <iostream>
-#include <unordered_map>
+#include <set>
 
 namespace fs = std::experimental::filesystem;
 
@@ -23,35 +28,33 @@ const std::vector<std::string> data_names{"dataset0.csv", "dataset1.csv",
 const std::vector<std::string> colors{"black", "red", "blue", "green", "cyan"};
 
 using DataType = double;
-using Coords = std::vector<DataType>;
-using PointCoords = std::pair<Coords, Coords>;
-using Clusters = std::unordered_map<size_t, PointCoords>;
 
-void PlotClusters(const Clusters& clusters,
+void PlotClusters(clustering::PointsView points,
+                  const std::vector<size_t>& labels,
                   const std::string& name,
                   const std::string& file_name) {
-  plotcpp::Plot plt;
-  plt.SetTerminal("png");
-  plt.SetOutput(file_name);
-  plt.SetTitle(name);
-  plt.SetXLabel("x");
-  plt.SetYLabel("y");
-  plt.SetAutoscale();
-  plt.GnuplotCommand("set grid");
-
-  auto draw_state = plt.StartDraw2D<Coords::const_iterator>();
-  for (auto& cluster : clusters) {
-    std::stringstream params;
-    params << "lc rgb '" << colors[cluster.first] << "' pt 7";
-    plt.AddDrawing(draw_state,
-                   plotcpp::Points(
-                       cluster.second.first.begin(), cluster.second.first.end(),
-                       cluster.second.second.begin(),
-                       std::to_string(cluster.first) + " cls", params.str()));
+  // binned to the image pixels and passed to gnuplot in binary form
+  clustering::DrawClusters(points, labels, colors, name, file_name);
+}
+
+clustering::Points ToPoints(UnlabeledData<RealVector>& features) {
+  clustering::Points points(features.numberOfElements(),
+                            dataDimension(features));
+  for (std::size_t i = 0; i != points.rows; i++) {
+    auto element = features.element(i);
+    for (std::size_t j = 0; j != points.cols; j++) {
+      points[i][j] = element(j);
+    }
   }
+  return points;
+}
 
-  plt.EndDraw2D(draw_state);
-  plt.Flush();
+// Cluster indices given by a Shark clustering model
+std::vector<size_t> ToLabels(const Data<unsigned>& clusters) {
+  std::vector<size_t> labels(clusters.numberOfElements());
+  for (std::size_t i = 0; i != labels.size(); i++)
+    labels[i] = clusters.element(i);
+  return labels;
 }
 
 void MakeHierarhicalClustering(UnlabeledData<RealVector>& features,
@@ -67,15 +70,8 @@ void MakeHierarhicalClustering(UnlabeledData<RealVector>& features,
   std::cout << "num clusters: " << clustering.numberOfClusters() << std::endl;
   Data<unsigned> clusters = model(features);
 
-  Clusters plot_clusters;
-  for (std::size_t i = 0; i != features.numberOfElements(); i++) {
-    auto cluser_idx = clusters.element(i);
-    auto element = features.element(i);
-    plot_clusters[cluser_idx].first.push_back(element(0));
-    plot_clusters[cluser_idx].second.push_back(element(1));
-  }
-
-  PlotClusters(plot_clusters, "Hierarchical", name + "-hierarchical.png");
+  PlotClusters(ToPoints(features).View(), ToLabels(clusters), "Hierarchical",
+               name + "-hierarchical.png");
 }
 
 void MakeKMeansClustering(UnlabeledData<RealVector>& features,
@@ -87,15 +83,91 @@ void MakeKMeansClustering(UnlabeledData<RealVector>& features,
   HardClusteringModel<RealVector> model(&centroids);
   Data<unsigned> clusters = model(features);
 
-  Clusters plot_clusters;
-  for (std::size_t i = 0; i != features.numberOfElements(); i++) {
-    auto cluser_idx = clusters.element(i);
-    auto element = features.element(i);
-    plot_clusters[cluser_idx].first.push_back(element(0));
-    plot_clusters[cluser_idx].second.push_back(element(1));
+  PlotClusters(ToPoints(features).View(), ToLabels(clusters), "K-Means",
+               name + "-kmeans.png");
+}
+
+// k-means|| seeding shared by all k-means variants below, Shark kMeans picks
+// its initial centers internally
+clustering::Points SeedCenters(clustering::PointsView points,
+                               const int num_clusters,
+                               const std::string& variant) {
+  auto start = std::chrono::steady_clock::now();
+  auto centers = clustering::KMeansParallelInit(points, num_clusters);
+  std::chrono::duration<double> seed_time =
+      std::chrono::steady_clock::now() - start;
+  std::cout << variant << " k-means|| seeding time: " << seed_time.count()
+            << "s" << std::endl;
+  return centers;
+}
+
+void MakeExactKMeansClustering(UnlabeledData<RealVector>& features,
+                               const int num_clusters,
+                               const std::string& name) {
+  auto points = ToPoints(features);
+  auto initial_centers = SeedCenters(points.View(), num_clusters, "exact");
+
+  auto result = clustering::KMeans(points.View(), initial_centers);
+  std::cout << "exact k-means iterations: " << result.iterations
+            << " inertia: " << result.inertia
+            << " distances computed: " << result.distances
+            << " skipped: " << result.skipped_distances << std::endl;
+
+  PlotClusters(points.View(), result.labels, "Exact K-Means",
+               name + "-exact-kmeans.png");
+}
+
+void MakeMiniBatchKMeansClustering(UnlabeledData<RealVector>& features,
+                                   const int num_clusters,
+                                   const std::string& name) {
+  auto points = ToPoints(features);
+  clustering::MiniBatchKMeans kmeans(num_clusters);
+  kmeans.SetCenters(SeedCenters(points.View(), num_clusters, "mini-batch"));
+  kmeans.Fit(points.View());
+  std::cout << "mini-batch k-means batches: "
+            << kmeans.GetMonitor().iterations
+            << " inertia: " << kmeans.Inertia(points.View()) << std::endl;
+
+  PlotClusters(points.View(), kmeans.Predict(points.View()),
+               "Mini-batch K-Means", name + "-minibatch-kmeans.png");
+}
+
+void MakeStreamingKMeansClustering(const fs::path& file_name,
+                                   const int num_clusters,
+                                   const std::string& name) {
+  // the file is never loaded at once, columns 1 and 2 are the coordinates
+  clustering::CsvChunkReader reader(file_name, {1, 2});
+  clustering::MiniBatchKMeans kmeans(num_clusters);
+  const std::size_t chunk_size = 4096;
+  clustering::Points chunk;
+  // seeds come from the first chunk only
+  if (reader.ReadChunk(chunk, chunk_size)) {
+    kmeans.SetCenters(SeedCenters(chunk.View(), num_clusters, "streaming"));
   }
+  reader.Rewind();
+  const std::size_t epochs = 10;
+  kmeans.Fit(reader, epochs);
+
+  // second pass assigns clusters chunk by chunk
+  reader.Rewind();
+  double inertia = 0;
+  // the plot needs every sample, chunks are appended to one matrix
+  clustering::Points points(0, 2);
+  std::vector<size_t> labels;
+  while (reader.ReadChunk(chunk, chunk_size)) {
+    inertia += kmeans.Inertia(chunk.View());
+    auto clusters = kmeans.Predict(chunk.View());
+    labels.insert(labels.end(), clusters.begin(), clusters.end());
+    points.values.insert(points.values.end(), chunk.values.begin(),
+                         chunk.values.begin() + chunk.rows * chunk.cols);
+    points.rows += chunk.rows;
+  }
+
+  std::cout << "streaming k-means batches: " << kmeans.GetMonitor().iterations
+            << " inertia: " << inertia << std::endl;
 
-  PlotClusters(plot_clusters, "K-Means", name + "-kmeans.png");
+  PlotClusters(points.View(), labels, "Streaming K-Means",
+               name + "-streaming-kmeans.png");
 }
 
 int main(int argc, char** argv) {
@@ -104,24 +176,46 @@ int main(int argc, char** argv) {
     for (auto& dataset : data_names) {
       auto dataset_name = base_dir / dataset;
       if (fs::exists(dataset_name)) {
-        ClassificationDataset data;
-        importCSV(data, dataset_name, LabelPosition::LAST_COLUMN);
-        data = selectInputFeatures(
-            data, std::vector<int>{1, 2});  // exclude index column
-
-        std::size_t num_samples = data.numberOfElements();
-        std::size_t num_features = dataDimension(data.inputs());
-        std::size_t num_clusters = numberOfClasses(data.labels());
+        // the parsed file is cached next to it, later runs map the cache
+        auto cache = csv::DatasetCache::Open(dataset_name.string());
+        if (!cache || cache->Cols() < 4) {
+          std::cerr << "Failed to read " << dataset_name << std::endl;
+          continue;
+        }
+        if (cache->WriteFailed())
+          std::cerr << "Failed to write the cache of " << dataset_name
+                    << std::endl;
+        // columns 1 and 2 are the coordinates, column 3 is the cluster
+        const auto* values = cache->Values();
+        const auto cols = cache->Cols();
+        std::vector<RealVector> points(cache->Rows(), RealVector(2));
+        std::set<DataType> labels;
+        for (std::size_t r = 0; r < cache->Rows(); ++r) {
+          points[r](0) = values[r * cols + 1];
+          points[r](1) = values[r * cols + 2];
+          labels.insert(values[r * cols + 3]);
+        }
+        auto inputs = createDataFromRange(points);
+
+        std::size_t num_samples = inputs.numberOfElements();
+        std::size_t num_features = dataDimension(inputs);
+        std::size_t num_clusters = labels.size();
         if (num_clusters < 2)
           num_clusters = 3;
 
         std::cout << dataset << "\n"
                   << "Num samples: " << num_samples
                   << " num features: " << num_features
-                  << " num clusters: " << num_clusters << std::endl;
-
-        MakeKMeansClustering(data.inputs(), num_clusters, dataset);
-        MakeHierarhicalClustering(data.inputs(), num_clusters, dataset);
+                  << " num clusters: " << num_clusters << "\n"
+                  << (cache->FromCache() ? "Warm" : "Cold")
+                  << " load time: " << cache->LoadSeconds() << "s"
+                  << std::endl;
+
+        MakeKMeansClustering(inputs, num_clusters, dataset);
+        MakeExactKMeansClustering(inputs, num_clusters, dataset);
+        MakeMiniBatchKMeansClustering(inputs, num_clusters, dataset);
+        MakeStreamingKMeansClustering(dataset_name, num_clusters, dataset);
+        MakeHierarhicalClustering(inputs, num_clusters, dataset);
       } else {
         std::cerr << "Dataset file " << dataset_name << " missed\n";
       }
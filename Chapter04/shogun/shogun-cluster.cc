@@ -1,21 +1,23 @@
-#include <plot.h>
+#include "../../Chapter02/csv/common/dataset_cache.h"
+#include "../common/cluster_plot.h"
+#include "../common/gmm.h"
+#include "../common/kmeans.h"
+#include "../common/kmeans_init.h"
 
 #include <shogun/base/init.h>
 #include <shogun/base/some.h>
-#include <shogun/clustering/GMM.h>
 #include <shogun/clustering/Hierarchical.h>
 #include <shogun/clustering/KMeans.h>
 #include <shogun/distance/EuclideanDistance.h>
-#include <shogun/io/File.h>
 #include <shogun/labels/MulticlassLabels.h>
 #include <shogun/lib/SGMatrix.h>
 #include <shogun/lib/SGStringList.h>
 #include <shogun/lib/SGVector.h>
 #include <shogun/util/factory.h>
 
+#include <chrono>
 #include <experimental/filesystem>
 #include <iostream>
-#include <unordered_map>
 
 namespace fs = std::experimental::filesystem;
 
@@ -29,59 +31,35 @@ const std::vector<std::string> data_names{"dataset0.csv", "dataset1.csv",
 
 const std::vector<std::string> colors{"black", "red", "blue", "green", "cyan"};
 
-using Coords = std::vector<DataType>;
-using PointCoords = std::pair<Coords, Coords>;
-using Clusters = std::unordered_map<index_t, PointCoords>;
-
-void PlotClusters(const Clusters& clusters,
+void PlotClusters(clustering::PointsView points,
+                  const std::vector<size_t>& labels,
                   const std::string& name,
                   const std::string& file_name) {
-  plotcpp::Plot plt;
-  plt.SetTerminal("png");
-  plt.SetOutput(file_name);
-  plt.SetTitle(name);
-  plt.SetXLabel("x");
-  plt.SetYLabel("y");
-  plt.SetAutoscale();
-  plt.GnuplotCommand("set grid");
-
-  auto draw_state = plt.StartDraw2D<Coords::const_iterator>();
-  for (auto& cluster : clusters) {
-    std::stringstream params;
-    params << "lc rgb '" << colors[cluster.first] << "' pt 7";
-    plt.AddDrawing(draw_state,
-                   plotcpp::Points(
-                       cluster.second.first.begin(), cluster.second.first.end(),
-                       cluster.second.second.begin(),
-                       std::to_string(cluster.first) + " cls", params.str()));
-  }
-
-  plt.EndDraw2D(draw_state);
-  plt.Flush();
+  // binned to the image pixels and passed to gnuplot in binary form
+  clustering::DrawClusters(points, labels, colors, name, file_name);
 }
 
 void MakeGMMClustering(Some<CDenseFeatures<DataType>> features,
                        const int num_clusters,
+                       clustering::CovarianceType covariance_type,
                        const std::string& name) {
-  std::cout << "GMM\n";
-  auto gmm = some<CGMM>(num_clusters);
-  gmm->set_features(features);
-  gmm->train_em();
-
-  Clusters clusters;
+  const bool full = covariance_type == clustering::CovarianceType::Full;
+  std::cout << "GMM " << (full ? "full" : "diagonal") << " covariance\n";
+  // samples are columns of the feature matrix, so it is used without a copy
   auto feature_matrix = features->get_feature_matrix();
-  for (index_t i = 0; i < features->get_num_vectors(); ++i) {
-    auto vector = feature_matrix.get_column(i);
-    auto log_likelihoods = gmm->cluster(vector);
-    auto max_el = std::max_element(log_likelihoods.begin(),
-                                   std::prev(log_likelihoods.end()));
-    auto label_idx =
-        static_cast<int>(std::distance(log_likelihoods.begin(), max_el));
-    clusters[label_idx].first.push_back(vector[0]);
-    clusters[label_idx].second.push_back(vector[1]);
-  }
-
-  PlotClusters(clusters, "GMM", name + "-gmm.png");
+  clustering::PointsView points{
+      feature_matrix.matrix, static_cast<size_t>(feature_matrix.num_cols),
+      static_cast<size_t>(feature_matrix.num_rows)};
+
+  clustering::GMMOptions options;
+  options.covariance_type = covariance_type;
+  clustering::GaussianMixture gmm(num_clusters, options);
+  gmm.Fit(points);
+  std::cout << "EM iterations : " << gmm.GetIterations()
+            << " log-likelihood : " << gmm.GetLogLikelihood() << std::endl;
+
+  PlotClusters(points, gmm.Predict(points), full ? "GMM" : "GMM diagonal",
+               name + (full ? "-gmm.png" : "-gmm-diag.png"));
 }
 
 void MakeKMeansClustering(Some<CDenseFeatures<DataType>> features,
@@ -89,22 +67,42 @@ void MakeKMeansClustering(Some<CDenseFeatures<DataType>> features,
                           const std::string& name) {
   std::cout << "K-Means\n";
   auto distance = some<CEuclideanDistance>(features, features);
-  auto clustering = some<CKMeans>(num_clusters, distance.get());
-  clustering->train(features);
-  std::cout << "Cluster centers :\n";
-  clustering->get_cluster_centers().display_matrix();
+  auto kmeans = some<CKMeans>(num_clusters, distance.get());
 
-  Clusters clusters;
+  // k-means|| seeding over the feature matrix without a copy, every sample
+  // is a contiguous column
   auto feature_matrix = features->get_feature_matrix();
-  CMulticlassLabels* result = clustering->apply()->as<CMulticlassLabels>();
+  clustering::PointsView points{
+      feature_matrix.matrix, static_cast<size_t>(feature_matrix.num_cols),
+      static_cast<size_t>(feature_matrix.num_rows)};
+  auto seed_start = std::chrono::steady_clock::now();
+  auto seeds = clustering::KMeansParallelInit(points, num_clusters);
+  std::chrono::duration<double> seed_time =
+      std::chrono::steady_clock::now() - seed_start;
+  Matrix initial_centers(feature_matrix.num_rows, num_clusters);
+  for (index_t c = 0; c < num_clusters; ++c) {
+    for (index_t j = 0; j < feature_matrix.num_rows; ++j) {
+      initial_centers(j, c) = seeds[c][j];
+    }
+  }
+  kmeans->set_initial_centers(initial_centers);
+  kmeans->train(features);
+  std::cout << "Cluster centers :\n";
+  kmeans->get_cluster_centers().display_matrix();
+
+  CMulticlassLabels* result = kmeans->apply()->as<CMulticlassLabels>();
+  std::vector<size_t> labels(static_cast<size_t>(result->get_num_labels()));
   for (index_t i = 0; i < result->get_num_labels(); ++i) {
     auto label_idx = static_cast<int>(result->get_label(i));
-    auto vector = feature_matrix.get_column(i);
-    clusters[label_idx].first.push_back(vector[0]);
-    clusters[label_idx].second.push_back(vector[1]);
+    labels[static_cast<size_t>(i)] = static_cast<size_t>(label_idx);
   }
 
-  PlotClusters(clusters, "K-Means", name + "-kmeans.png");
+  std::cout << "k-means|| seeding time : " << seed_time.count()
+            << "s, final inertia : "
+            << clustering::PartitionInertia(points, labels, num_clusters)
+            << std::endl;
+
+  PlotClusters(points, labels, "K-Means", name + "-kmeans.png");
 }
 
 int main(int argc, char** argv) {
@@ -114,26 +112,33 @@ int main(int argc, char** argv) {
     for (auto& dataset : data_names) {
       auto dataset_name = base_dir / dataset;
       if (fs::exists(dataset_name)) {
-        auto csv_file = some<CCSVFile>(dataset_name.string().c_str());
-        Matrix data;
-        data.load(csv_file);
-
-        // Exclude cluster and index info from data
-        // Shogun csv loader loads matrixes in column major order
-        Matrix::transpose_matrix(data.matrix, data.num_rows, data.num_cols);
-        Matrix inputs = data.submatrix(1, data.num_cols - 1);  // make a view
-        inputs = inputs.clone();                // copy exact data
-        Matrix outputs = data.submatrix(3, 4);  // make a view
-        outputs = outputs.clone();              // copy exact data
-
-        // Transpose back because shogun algorithms expect that samples are in
-        // colums
-        Matrix::transpose_matrix(inputs.matrix, inputs.num_rows,
-                                 inputs.num_cols);
+        // the parsed file is cached next to it, later runs map the cache
+        auto cache = csv::DatasetCache::Open(dataset_name.string());
+        if (!cache || cache->Cols() < 4) {
+          std::cerr << "Failed to read " << dataset_name << std::endl;
+          continue;
+        }
+        if (cache->WriteFailed())
+          std::cerr << "Failed to write the cache of " << dataset_name
+                    << std::endl;
+
+        // The row-major cached values are a column-major matrix with samples
+        // in columns, as shogun algorithms expect. Rows 1 and 2 of it are the
+        // coordinates and row 3 is the cluster, index info is excluded.
+        const auto cols = static_cast<index_t>(cache->Cols());
+        const auto rows = static_cast<index_t>(cache->Rows());
+        Matrix data(cache->Values(), cols, rows, false);
+        Matrix inputs(2, rows);
+        SGVector<DataType> outputs(rows);
+        for (index_t r = 0; r < rows; ++r) {
+          inputs(0, r) = data(1, r);
+          inputs(1, r) = data(2, r);
+          outputs[r] = data(3, r);
+        }
 
         // create a dataset
         auto features = some<CDenseFeatures<DataType>>(inputs);
-        auto cluster_labels = some<CMulticlassLabels>(outputs.get_column(0));
+        auto cluster_labels = some<CMulticlassLabels>(outputs);
         auto num_clusters = cluster_labels->get_num_classes();
         if (num_clusters > 3 || num_clusters < 2)
           num_clusters = 3;
@@ -145,9 +150,14 @@ int main(int argc, char** argv) {
         std::cout << "Num samples : " << features->get_num_vectors()
                   << std::endl;
         std::cout << "Num clusters : " << num_clusters << std::endl;
+        std::cout << (cache->FromCache() ? "Warm" : "Cold")
+                  << " load time: " << cache->LoadSeconds() << "s" << std::endl;
 
         MakeKMeansClustering(features, num_clusters, dataset);
-        MakeGMMClustering(features, num_clusters, dataset);
+        MakeGMMClustering(features, num_clusters,
+                          clustering::CovarianceType::Full, dataset);
+        MakeGMMClustering(features, num_clusters,
+                          clustering::CovarianceType::Diagonal, dataset);
       } else {
         std::cerr << "Dataset file " << dataset_name << " missed\n";
       }
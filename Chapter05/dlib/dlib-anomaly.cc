@@ -2,10 +2,12 @@
 #include <dlib/svm.h>
 #include <plot.h>
 
+#include "../../Chapter02/csv/common/dataset_cache.h"
 #include "isolation-forest.h"
 
 #include <experimental/filesystem>
 #include <iostream>
+#include <stdexcept>
 #include <unordered_map>
 
 using namespace dlib;
@@ -191,9 +193,17 @@ using Dataset = std::pair<Matrix, Matrix>;
 
 Dataset LoadDataset(const fs::path& file_path) {
   if (fs::exists(file_path)) {
-    std::ifstream file(file_path);
-    matrix<DataType> data;
-    file >> data;
+    // the parsed file is cached next to it, later runs map the cache
+    auto cache = csv::DatasetCache::Open(file_path.string());
+    if (!cache)
+      throw std::runtime_error("Failed to read " + file_path.string());
+    if (cache->WriteFailed())
+      std::cerr << "Failed to write the cache of " << file_path << std::endl;
+    std::cout << file_path.filename() << " "
+              << (cache->FromCache() ? "warm" : "cold")
+              << " load time: " << cache->LoadSeconds() << "s" << std::endl;
+    auto data = mat(cache->Values(), static_cast<long>(cache->Rows()),
+                    static_cast<long>(cache->Cols()));
 
     long n_normal = 50;
     Matrix normal =
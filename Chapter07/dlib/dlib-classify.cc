@@ -1,3 +1,5 @@
+#include "../../Chapter02/csv/common/dataset_cache.h"
+
 #include <dlib/matrix.h>
 #include <dlib/svm_threaded.h>
 #include <plot.h>
@@ -124,9 +126,17 @@ int main(int argc, char** argv) {
     for (auto& dataset : data_names) {
       auto dataset_name = base_dir / dataset;
       if (fs::exists(dataset_name)) {
-        std::ifstream file(dataset_name);
-        matrix<DataType> data;
-        file >> data;
+        // the parsed file is cached next to it, later runs map the cache
+        auto cache = csv::DatasetCache::Open(dataset_name.string());
+        if (!cache || cache->Cols() < 4) {
+          std::cerr << "Failed to read " << dataset_name << std::endl;
+          continue;
+        }
+        if (cache->WriteFailed())
+          std::cerr << "Failed to write the cache of " << dataset_name
+                    << std::endl;
+        auto data = mat(cache->Values(), static_cast<long>(cache->Rows()),
+                        static_cast<long>(cache->Cols()));
 
         auto inputs = dlib::subm(data, 0, 1, data.nr(), 2);
         auto outputs = dlib::subm(data, 0, 3, data.nr(), 1);
@@ -139,7 +149,10 @@ int main(int argc, char** argv) {
         std::cout << dataset << "\n"
                   << "Num samples: " << num_samples
                   << " num features: " << num_features
-                  << " num clusters: " << num_clusters << std::endl;
+                  << " num clusters: " << num_clusters << "\n"
+                  << (cache->FromCache() ? "Warm" : "Cold")
+                  << " load time: " << cache->LoadSeconds() << "s"
+                  << std::endl;
 
         // split data set to the train and test parts
         long test_num = 300;
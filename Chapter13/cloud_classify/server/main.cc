@@ -3,6 +3,8 @@
 #include <httplib/httplib.h>
 #include "utils.h"
 
+#include <chrono>
+
 int main(int argc, char** argv) {
   try {
     std::string snapshoot_path;
@@ -56,7 +58,12 @@ int main(int argc, char** argv) {
           std::cout << file.second.filename << std::endl;
           std::cout << file.second.content_type << std::endl;
           try {
+            auto start = std::chrono::steady_clock::now();
             auto img = ReadMemoryImageTensor(body, 224, 224);
+            std::chrono::duration<double, std::milli> preprocess_time =
+                std::chrono::steady_clock::now() - start;
+            std::cout << "Decoding and preprocessing time "
+                      << preprocess_time.count() << " ms" << std::endl;
             auto class_name = network.Classify(img);
             response_string += "; " + class_name;
           } catch (...) {
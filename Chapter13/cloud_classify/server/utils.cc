@@ -25,64 +25,83 @@ Classes ReadClasses(const std::string& file_name) {
   return classes;
 }
 
-torch::Tensor CvImageToTensor(cv::Mat image, int width, int height) {
-  if (!image.cols || !image.rows) {
-    return {};
-  }
+namespace {
+// ImageNet statistics of RGB channels
+const float kMean[3] = {0.485f, 0.456f, 0.406f};
+const float kStddev[3] = {0.229f, 0.224f, 0.225f};
 
-  if (image.cols != width || image.rows != height) {
-    // scale image to fit
-    cv::Size scaled(std::max(height * image.cols / image.rows, width),
-                    std::max(height, width * image.rows / image.cols));
-    cv::resize(image, image, scaled);
+// Scales the image to cover width x height and crops the center. Only the
+// crop is computed: the inverse affine map takes every crop pixel to the
+// source position cv::resize with INTER_LINEAR would sample for it.
+void ResizeCrop(const cv::Mat& image, int width, int height, cv::Mat& crop) {
+  cv::Size scaled(std::max(height * image.cols / image.rows, width),
+                  std::max(height, width * image.rows / image.cols));
+  const double sx = static_cast<double>(image.cols) / scaled.width;
+  const double sy = static_cast<double>(image.rows) / scaled.height;
+  const int x0 = (scaled.width - width) / 2;
+  const int y0 = (scaled.height - height) / 2;
+  cv::Mat transform = (cv::Mat_<double>(2, 3) << sx, 0, (x0 + 0.5) * sx - 0.5,
+                       0, sy, (y0 + 0.5) * sy - 0.5);
+  cv::warpAffine(image, crop, transform, {width, height},
+                 cv::INTER_LINEAR | cv::WARP_INVERSE_MAP,
+                 cv::BORDER_REPLICATE);
+}
 
-    // crop image to fit
-    cv::Rect crop((image.cols - width) / 2, (image.rows - height) / 2, width,
-                  height);
-    image = image(crop);
+// Writes BGR pixels as normalized RGB planes, ((c / 255) - mean) / stddev
+// is folded into one multiply-add per value
+void ToNormalizedPlanes(const cv::Mat& bgr, float* dst) {
+  float scale[3];
+  float shift[3];
+  for (int c = 0; c < 3; ++c) {
+    scale[c] = 1.f / (255.f * kStddev[c]);
+    shift[c] = -kMean[c] / kStddev[c];
   }
+  const auto plane_size = static_cast<size_t>(bgr.rows * bgr.cols);
+  for (int r = 0; r < bgr.rows; ++r) {
+    const auto* pixels = bgr.ptr<uint8_t>(r);
+    float* red = dst + static_cast<size_t>(r * bgr.cols);
+    float* green = red + plane_size;
+    float* blue = green + plane_size;
+    for (int x = 0; x < bgr.cols; ++x) {
+      blue[x] = pixels[3 * x] * scale[2] + shift[2];
+      green[x] = pixels[3 * x + 1] * scale[1] + shift[1];
+      red[x] = pixels[3 * x + 2] * scale[0] + shift[0];
+    }
+  }
+}
+}  // namespace
 
-  image.convertTo(image, CV_32FC3);
-  cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-
-  CAFFE_ENFORCE_EQ(image.channels(), 3);
-  CAFFE_ENFORCE_EQ(image.rows, height);
-  CAFFE_ENFORCE_EQ(image.cols, width);
-
-  std::vector<cv::Mat> channels(3);
-  cv::split(image, channels);
-
-  std::vector<double> mean = {0.485, 0.456, 0.406};
-  std::vector<double> stddev = {0.229, 0.224, 0.225};
-
-  size_t i = 0;
-  for (auto& c : channels) {
-    c = ((c / 255) - mean[i]) / stddev[i];
-    ++i;
+// Two passes over the output size only: a resize into the crop window and
+// the normalization straight into the tensor memory
+torch::Tensor CvImageToTensor(const cv::Mat& image, int width, int height) {
+  if (!image.cols || !image.rows) {
+    return {};
   }
+  CAFFE_ENFORCE_EQ(image.type(), CV_8UC3);
 
-  cv::vconcat(channels[0], channels[1], image);
-  cv::vconcat(image, channels[2], image);
-  assert(image.isContinuous());
+  // reused by the requests of the server thread
+  thread_local cv::Mat crop;
+  const cv::Mat* bgr = &image;
+  if (image.cols != width || image.rows != height) {
+    ResizeCrop(image, width, height, crop);
+    bgr = &crop;
+  }
 
-  // create tensor
-  std::vector<int64_t> dims = {1, 3, height, width};
-  auto tensor = torch::from_blob(image.data, dims,
-                                 torch::TensorOptions()
-                                     .device(at::kCPU)
-                                     .dtype(at::kFloat)
-                                     .requires_grad(false));
-  return tensor.clone();
+  auto tensor = torch::empty({1, 3, height, width},
+                             torch::TensorOptions()
+                                 .device(at::kCPU)
+                                 .dtype(at::kFloat)
+                                 .requires_grad(false));
+  ToNormalizedPlanes(*bgr, static_cast<float*>(tensor.data_ptr()));
+  return tensor;
 }
 
 torch::Tensor ReadMemoryImageTensor(const std::string& data,
                                     int width,
                                     int height) {
-  // load image
-  cv::Mat image;
-  {
-    std::vector<char> buf(data.begin(), data.end());
-    image = cv::imdecode(buf, cv::IMREAD_COLOR);
-  }
+  // load image, the request body is decoded in place
+  cv::Mat buf(1, static_cast<int>(data.size()), CV_8UC1,
+              const_cast<char*>(data.data()));
+  cv::Mat image = cv::imdecode(buf, cv::IMREAD_COLOR);
   return CvImageToTensor(image, width, height);
 }
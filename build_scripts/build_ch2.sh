@@ -32,7 +32,7 @@ cmake --build . --target all
 cd $START_DIR/Chapter02/hdf5/cpp
 mkdir build
 cd build/
-cmake -DHIGHFIVE_LIB_PATH=$LIBS_DIR/include/ -DJSON_LIB_PATH=$LIBS_DIR/include/rapidjson/ ..
+cmake -DJSON_LIB_PATH=$LIBS_DIR/include/ -DEIGEN_LIB_PATH=$LIBS_DIR/include/eigen3/ ..
 cmake --build . --target all
 
 cd $START_DIR/Chapter02/json/cpp
@@ -43,9 +43,6 @@ mkdir libs/sources
 # ONNX
 . ./install_lib.sh https://github.com/onnx/onnx.git 28ca699b69b5a31892619defca2391044a9a6052 -DONNX_NAMESPACE=onnx_torch
 
-# HighFive
-. ./install_lib.sh https://github.com/BlueBrain/HighFive 41b0390d6102184b1b6617cefb3fe89ef9cbe07d
-
 # cpp-httplib
 . ./install_lib.sh https://github.com/yhirose/cpp-httplib 2c6da365d98c640b9cff4b3a7eb213673ba25910
 